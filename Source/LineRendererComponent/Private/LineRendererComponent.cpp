@@ -1,211 +1,636 @@
-// Copyright 2023 Petr Leontev. All Rights Reserved.
-
-#include "LineRendererComponent.h"
-#include "BatchedElements.h"
-#include "Materials/MaterialInterface.h"
-#include "Materials/MaterialInstanceDynamic.h"
-#include "Materials/MaterialRelevance.h"
-#include "LineRendererComponentSceneProxy.h"
-#include "LineSectionInfo.h"
-
-
-ULineRendererComponent::ULineRendererComponent(const FObjectInitializer& ObjectInitializer)
-: Super(ObjectInitializer)
-{
-}
-
-void ULineRendererComponent::CreateLine2Points(int32 SectionIndex, const FVector& StartPoint, const FVector& EndPoint, const FLinearColor& Color, float Thickness, int32 NumSegments, bool bScreenSpace)
-{
-    if (NumSegments == 1)
-    {
-        CreateLine(SectionIndex, { StartPoint, EndPoint }, Color, Thickness, bScreenSpace);
-        return;
-    }
-
-    const FVector Step = (EndPoint - StartPoint) / FMath::Max(NumSegments, 1);
-
-    TArray<FVector> Vertices;
-
-    for (int32 SegmentInd = 0; SegmentInd <= NumSegments; ++SegmentInd)
-    {
-        const FVector& CurrPoint = StartPoint + Step * SegmentInd;
-        Vertices.Add(CurrPoint);
-    }
-
-    CreateLine(SectionIndex, Vertices, Color, Thickness, bScreenSpace);
-}
-
-void ULineRendererComponent::CreateLine(int32 SectionIndex, const TArray<FVector>& Vertices, const FLinearColor& Color, float Thickness, bool bScreenSpace)
-{
-    FLineSectionInfo Section;
-
-    FLineSectionInfo* NewSection = &Section;
-
-    NewSection->SectionIndex = SectionIndex;
-    NewSection->Color = Color;
-    NewSection->bScreenSpace = bScreenSpace;
-
-    for (int32 Ind = 0; Ind < Vertices.Num() - 1; ++Ind)
-    {
-        const FVector& StartPoint = Vertices[Ind];
-        const FVector& EndPoint = Vertices[Ind + 1];
-
-        FBatchedLine& Line = NewSection->Lines.AddDefaulted_GetRef();
-        {
-            Line.Start = StartPoint;
-            Line.End = EndPoint;
-            Line.Color = Color;
-            Line.Thickness = Thickness > 0.0f ? Thickness : 1.0f;
-        }
-    }
-
-    NewSection->Material = CreateOrUpdateMaterial(SectionIndex, Color);
-
-    Sections.Add(SectionIndex, Section);
-
-    MarkRenderStateDirty();
-}
-
-void ULineRendererComponent::RemoveLine(int32 SectionIndex)
-{
-	FLineRendererComponentSceneProxy* LineSceneProxy = (FLineRendererComponentSceneProxy*)SceneProxy;
-    if (LineSceneProxy == nullptr)
-    {
-        return;
-    }
-
-    LineSceneProxy->ClearMeshSection(SectionIndex);
-
-    Sections.Remove(SectionIndex);
-    SectionMaterials.Remove(SectionIndex);
-}
-
-void ULineRendererComponent::RemoveAllLines()
-{
-	FLineRendererComponentSceneProxy* LineSceneProxy = (FLineRendererComponentSceneProxy*)SceneProxy;
-    if (LineSceneProxy == nullptr)
-    {
-        return;
-    }
-
-    LineSceneProxy->ClearAllMeshSections();
-
-    Sections.Empty();
-    SectionMaterials.Empty();
-}
-
-void ULineRendererComponent::SetLineVisible(int32 SectionIndex, bool bNewVisibility)
-{
-	FLineRendererComponentSceneProxy* LineSceneProxy = (FLineRendererComponentSceneProxy*)SceneProxy;
-    if (LineSceneProxy == nullptr)
-    {
-        return;
-    }
-
-    LineSceneProxy->SetMeshSectionVisible(SectionIndex, bNewVisibility);
-}
-
-bool ULineRendererComponent::IsLineVisible(int32 SectionIndex) const
-{
-    FLineRendererComponentSceneProxy* LineSceneProxy = (FLineRendererComponentSceneProxy*)SceneProxy;
-    if (LineSceneProxy == nullptr)
-    {
-        return false;
-    }
-
-    return LineSceneProxy->IsMeshSectionVisible(SectionIndex);
-}
-
-int32 ULineRendererComponent::GetNumSections() const
-{
-	FLineRendererComponentSceneProxy* LineSceneProxy = (FLineRendererComponentSceneProxy*)SceneProxy;
-    if (LineSceneProxy == nullptr)
-    {
-        return 0;
-    }
-
-	return LineSceneProxy->GetNumSections();
-}
-
-FPrimitiveSceneProxy* ULineRendererComponent::CreateSceneProxy()
-{
-    if (Sections.Num() > 0)
-    {
-        return new FLineRendererComponentSceneProxy(this);
-    }
-
-    return nullptr;
-}
-
-UMaterialInterface* ULineRendererComponent::GetMaterial(int32 ElementIndex) const
-{
-    if (SectionMaterials.Contains(ElementIndex))
-    {
-        return SectionMaterials[ElementIndex];
-    }
-
-    return nullptr;
-}
-
-FMaterialRelevance ULineRendererComponent::GetMaterialRelevance(ERHIFeatureLevel::Type InFeatureLevel) const
-{
-    if (IsValid(LineMaterial))
-    {
-        return LineMaterial->GetRelevance_Concurrent(InFeatureLevel);
-    }
-    return FMaterialRelevance();
-}
-
-void ULineRendererComponent::GetUsedMaterials(TArray<UMaterialInterface*>& OutMaterials, bool bGetDebugMaterials /*= false*/) const
-{
-    Super::GetUsedMaterials(OutMaterials, bGetDebugMaterials);
-
-    OutMaterials.Add(LineMaterial);
-
-    for (TTuple<int32, UMaterialInstanceDynamic*> KeyValuePair : SectionMaterials)
-    {
-        OutMaterials.Add(KeyValuePair.Value);
-    }
-}
-
-UMaterialInterface* ULineRendererComponent::CreateOrUpdateMaterial(int32 SectionIndex, const FLinearColor& Color)
-{
-    if (!SectionMaterials.Contains(SectionIndex))
-    {
-        UMaterialInstanceDynamic* MI = UMaterialInstanceDynamic::Create(LineMaterial, this);
-        SectionMaterials.Add(SectionIndex, MI);
-    }
-
-    UMaterialInstanceDynamic* MI = SectionMaterials[SectionIndex];
-    MI->SetVectorParameterValue(TEXT("LineColor"), Color);
-
-    return MI;
-}
-
-FBoxSphereBounds ULineRendererComponent::CalcBounds(const FTransform& LocalToWorld) const
-{
-    FBoxSphereBounds LocalBounds(FVector(0, 0, 0), FVector(0, 0, 0), 0);
-
-    for (const TTuple<int32, FLineSectionInfo>& SectionInfo : Sections) 
-    {
-        const FLineSectionInfo& Section = SectionInfo.Value;
-
-        for (const FBatchedLine& Line : Section.Lines) 
-        {
-            LocalBounds = LocalBounds + FBoxSphereBounds(Line.Start, FVector(Line.Thickness), Line.Thickness);
-            LocalBounds = LocalBounds + FBoxSphereBounds(Line.End, FVector(Line.Thickness), Line.Thickness);
-        }
-    }
-
-    FBoxSphereBounds Ret(FBoxSphereBounds(LocalBounds).TransformBy(LocalToWorld));
-
-    Ret.BoxExtent *= BoundsScale;
-    Ret.SphereRadius *= BoundsScale;
-
-    return Ret;
-}
-
-void ULineRendererComponent::UpdateBounds()
-{
-    Bounds = CalcBounds(FTransform(GetRenderMatrix()));
-}
+// Copyright 2023 Petr Leontev. All Rights Reserved.
+
+#include "LineRendererComponent.h"
+#include "BatchedElements.h"
+#include "Materials/MaterialInterface.h"
+#include "Materials/MaterialInstanceDynamic.h"
+#include "Materials/MaterialRelevance.h"
+#include "LineRendererComponentSceneProxy.h"
+#include "LineSectionInfo.h"
+#include "LineRendererStats.h"
+#include "LineTopologyBuffers.h"
+#include "HAL/IConsoleManager.h"
+#include "UObject/UObjectIterator.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogLineRenderer, Log, All);
+
+static void DumpLineRendererMemory()
+{
+    FLineSectionMemoryStats Total;
+
+    for (TObjectIterator<ULineRendererComponent> It; It; ++It)
+    {
+        TMap<int32, FLineSectionMemoryStats> SectionStats;
+        const FLineSectionMemoryStats ComponentStats = It->GetLineMemoryStats(&SectionStats);
+
+        UE_LOG(LogLineRenderer, Log, TEXT("%s: %d sections, GPU %llu bytes (vertex %llu, index %llu, UV %llu, color %llu), CPU lines %llu bytes"),
+            *It->GetPathName(), SectionStats.Num(), (uint64)ComponentStats.GetGPUBytes(),
+            (uint64)ComponentStats.VertexBytes, (uint64)ComponentStats.IndexBytes, (uint64)ComponentStats.UVBytes, (uint64)ComponentStats.ColorBytes, (uint64)ComponentStats.LineBytes);
+
+        for (const TTuple<int32, FLineSectionMemoryStats>& KeyValuePair : SectionStats)
+        {
+            const FLineSectionMemoryStats& Stats = KeyValuePair.Value;
+
+            UE_LOG(LogLineRenderer, Log, TEXT("    Section %d: vertex %llu, index %llu, UV %llu, color %llu, CPU lines %llu bytes"),
+                KeyValuePair.Key, (uint64)Stats.VertexBytes, (uint64)Stats.IndexBytes, (uint64)Stats.UVBytes, (uint64)Stats.ColorBytes, (uint64)Stats.LineBytes);
+        }
+
+        Total += ComponentStats;
+    }
+
+    UE_LOG(LogLineRenderer, Log, TEXT("Total: GPU %llu bytes, CPU lines %llu bytes"), (uint64)Total.GetGPUBytes(), (uint64)Total.LineBytes);
+    UE_LOG(LogLineRenderer, Log, TEXT("Shared topology buffers: %llu bytes"), (uint64)FLineTopologyBuffers::GetTotalAllocatedBytes());
+}
+
+static FAutoConsoleCommand CmdLineRendererDumpMemory(
+    TEXT("LineRenderer.DumpMemory"),
+    TEXT("Logs GPU vertex, index, UV and color bytes and CPU line storage of every line renderer component and section"),
+    FConsoleCommandDelegate::CreateStatic(&DumpLineRendererMemory));
+
+
+/** Box of the polyline points grown by the line thickness */
+static FBox CalcPointsBox(TConstArrayView<FVector3f> Points, float Thickness)
+{
+    FBox3f Box(ForceInit);
+
+    for (const FVector3f& Point : Points)
+    {
+        Box += Point;
+    }
+
+    return Box.IsValid ? FBox(Box.ExpandBy(Thickness)) : FBox(ForceInit);
+}
+
+/** Whether a point lies on a side of the box of the points, within float precision of the stored box */
+static bool IsOnBoxSide(const FBox& Box, const FVector3f& Point)
+{
+    if (!Box.IsValid)
+    {
+        return true;
+    }
+
+    const double Tolerance = UE_KINDA_SMALL_NUMBER * FMath::Max(Box.GetExtent().GetMax() + Box.GetCenter().GetAbsMax(), 1.0);
+
+    for (int32 Axis = 0; Axis < 3; ++Axis)
+    {
+        if (Point[Axis] <= Box.Min[Axis] + Tolerance || Point[Axis] >= Box.Max[Axis] - Tolerance)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+ULineRendererComponent::ULineRendererComponent(const FObjectInitializer& ObjectInitializer)
+: Super(ObjectInitializer)
+, bGPUExpansion(false)
+, bVertexColor(false)
+, LineGeometryMode(ELineGeometryMode::Caps)
+, bStaticLines(false)
+, SectionBuildMode(ELineSectionBuildMode::BlockUntilReady)
+{
+}
+
+void ULineRendererComponent::CreateLine2Points(int32 SectionIndex, const FVector& StartPoint, const FVector& EndPoint, const FLinearColor& Color, float Thickness, int32 NumSegments, bool bScreenSpace)
+{
+    if (NumSegments == 1)
+    {
+        CreateLine(SectionIndex, { StartPoint, EndPoint }, Color, Thickness, bScreenSpace);
+        return;
+    }
+
+    const FVector Step = (EndPoint - StartPoint) / FMath::Max(NumSegments, 1);
+
+    TArray<FVector> Vertices;
+
+    for (int32 SegmentInd = 0; SegmentInd <= NumSegments; ++SegmentInd)
+    {
+        const FVector& CurrPoint = StartPoint + Step * SegmentInd;
+        Vertices.Add(CurrPoint);
+    }
+
+    CreateLine(SectionIndex, Vertices, Color, Thickness, bScreenSpace);
+}
+
+void ULineRendererComponent::CreateLine(int32 SectionIndex, const TArray<FVector>& Vertices, const FLinearColor& Color, float Thickness, bool bScreenSpace)
+{
+    FLineSectionDescription Description;
+    Description.SectionIndex = SectionIndex;
+    Description.Vertices = Vertices;
+    Description.Color = Color;
+    Description.Thickness = Thickness;
+    Description.bScreenSpace = bScreenSpace;
+
+    // Recreated sections stay hidden if they were hidden before
+    if (const FLineSectionInfo* ExistingSection = Sections.Find(SectionIndex))
+    {
+        Description.bVisible = ExistingSection->bVisible;
+    }
+
+    AddSection(Description);
+    UpdateLocalLinesBox();
+    SendSectionsToProxy(MakeArrayView(&SectionIndex, 1));
+}
+
+void ULineRendererComponent::CreateLines(const TArray<FLineSectionDescription>& Lines)
+{
+    TArray<int32> SectionIndices;
+    SectionIndices.Reserve(Lines.Num());
+
+    for (const FLineSectionDescription& Description : Lines)
+    {
+        AddSection(Description);
+        SectionIndices.AddUnique(Description.SectionIndex);
+    }
+
+    UpdateLocalLinesBox();
+    SendSectionsToProxy(SectionIndices);
+}
+
+void ULineRendererComponent::UpdateLines(const TArray<FLineSectionDescription>& Lines)
+{
+    TArray<int32> SectionIndices;
+    SectionIndices.Reserve(Lines.Num());
+
+    for (const FLineSectionDescription& Description : Lines)
+    {
+        if (!Sections.Contains(Description.SectionIndex))
+        {
+            continue;
+        }
+
+        AddSection(Description);
+        SectionIndices.AddUnique(Description.SectionIndex);
+    }
+
+    UpdateLocalLinesBox();
+    SendSectionsToProxy(SectionIndices);
+}
+
+void ULineRendererComponent::AddSection(const FLineSectionDescription& Description)
+{
+    LINE_RENDERER_SCOPE_CYCLE_COUNTER(STAT_LineRenderer_StoreSections);
+
+    const int32 SectionIndex = Description.SectionIndex;
+    const TArray<FVector>& Vertices = Description.Vertices;
+
+    FLineSectionInfo Section;
+
+    FLineSectionInfo* NewSection = &Section;
+
+    NewSection->SectionIndex = SectionIndex;
+    NewSection->Color = Description.Color;
+    NewSection->bScreenSpace = Description.bScreenSpace;
+    NewSection->bVisible = Description.bVisible;
+    NewSection->Thickness = Description.Thickness > 0.0f ? Description.Thickness : 1.0f;
+
+    NewSection->Points.Reserve(Vertices.Num());
+
+    for (const FVector& Vertex : Vertices)
+    {
+        NewSection->Points.Add(FVector3f(Vertex));
+    }
+
+    NewSection->LocalBox = CalcPointsBox(NewSection->Points, NewSection->Thickness);
+
+    if (bVertexColor)
+    {
+        // Color travels with the vertices, all sections share LineMaterial and can be drawn together
+        NewSection->Material = LineMaterial;
+    }
+    else
+    {
+        NewSection->Material = CreateOrUpdateMaterial(SectionIndex, Description.Color);
+    }
+
+    Sections.Add(SectionIndex, MoveTemp(Section));
+}
+
+void ULineRendererComponent::SendSectionsToProxy(TConstArrayView<int32> SectionIndices)
+{
+    if (SectionIndices.Num() == 0)
+    {
+        return;
+    }
+
+    FLineRendererComponentSceneProxy* LineSceneProxy = (FLineRendererComponentSceneProxy*)SceneProxy;
+    if (LineSceneProxy == nullptr || ChangesStaticSections(SectionIndices))
+    {
+        MarkRenderStateDirty();
+        return;
+    }
+
+    // Pointers are taken once all sections are added, adding to the map may move its elements
+    TArray<const FLineSectionInfo*> ChangedSections;
+    ChangedSections.Reserve(SectionIndices.Num());
+
+    for (int32 SectionIndex : SectionIndices)
+    {
+        ChangedSections.Add(Sections.Find(SectionIndex));
+    }
+
+    // Only the changed sections are sent to the live proxy, bounds are pushed with the next transform update
+    LineSceneProxy->UpdateMeshSections(ChangedSections);
+
+    MarkRenderTransformDirty();
+}
+
+bool ULineRendererComponent::ChangesStaticSections(TConstArrayView<int32> SectionIndices) const
+{
+    if (!bStaticLines)
+    {
+        return false;
+    }
+
+    const FLineRendererComponentSceneProxy* LineSceneProxy = (const FLineRendererComponentSceneProxy*)SceneProxy;
+
+    for (int32 SectionIndex : SectionIndices)
+    {
+        // Static before the change, or static after it
+        if (LineSceneProxy != nullptr && LineSceneProxy->IsStaticSection(SectionIndex))
+        {
+            return true;
+        }
+
+        const FLineSectionInfo* Section = Sections.Find(SectionIndex);
+        if (Section != nullptr && !Section->bScreenSpace)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void ULineRendererComponent::AppendPointsToLine(int32 SectionIndex, const TArray<FVector>& Points, const FLinearColor& Color, float Thickness, bool bScreenSpace, int32 MaxPoints)
+{
+    LINE_RENDERER_SCOPE_CYCLE_COUNTER(STAT_LineRenderer_StoreSections);
+
+    const int32 MaxLines = MaxPoints > 0 ? FMath::Max(MaxPoints - 1, 1) : 0;
+
+    FLineSectionInfo* Section = Sections.Find(SectionIndex);
+
+    // Nothing to continue from, the points start a new line
+    if (Section == nullptr)
+    {
+        const int32 NumPoints = MaxPoints > 0 ? FMath::Min(Points.Num(), MaxLines + 1) : Points.Num();
+        CreateLine(SectionIndex, TArray<FVector>(Points.GetData() + Points.Num() - NumPoints, NumPoints), Color, Thickness, bScreenSpace);
+        return;
+    }
+
+    if (Points.Num() == 0)
+    {
+        return;
+    }
+
+    // A section of a single point has nothing drawn yet, the proxy gets all of its lines at once
+    const bool bHadLines = Section->GetNumLines() > 0;
+
+    // Every new point ends a line starting at the previous last point
+    const int32 FirstNewPoint = Section->Points.Num();
+    Section->Points.Reserve(FirstNewPoint + Points.Num());
+
+    for (const FVector& Point : Points)
+    {
+        Section->Points.Add(FVector3f(Point));
+    }
+
+    Section->LocalBox += CalcPointsBox(MakeArrayView(Section->Points).RightChop(FirstNewPoint), Section->Thickness);
+
+    // Ring buffer mode drops the oldest lines by moving the first point, dropped lines keep the box conservative
+    if (MaxLines > 0 && Section->GetNumLines() > MaxLines)
+    {
+        Section->FirstPoint += Section->GetNumLines() - MaxLines;
+    }
+
+    // Dropped points are removed once they outnumber the others, which keeps appends amortized O(1)
+    if (Section->FirstPoint > Section->GetNumPoints())
+    {
+        Section->Points.RemoveAt(0, Section->FirstPoint, false);
+        Section->FirstPoint = 0;
+
+        // The removal visits every point anyway, the box shrinks back to the lines left
+        Section->LocalBox = CalcPointsBox(Section->Points, Section->Thickness);
+        UpdateLocalLinesBox();
+    }
+    else
+    {
+        LocalLinesBox += Section->LocalBox;
+    }
+
+    if (Section->GetNumLines() == 0)
+    {
+        return;
+    }
+
+    FLineRendererComponentSceneProxy* LineSceneProxy = (FLineRendererComponentSceneProxy*)SceneProxy;
+    if (LineSceneProxy == nullptr || !bHadLines || ChangesStaticSections(MakeArrayView(&SectionIndex, 1)))
+    {
+        SendSectionsToProxy(MakeArrayView(&SectionIndex, 1));
+        return;
+    }
+
+    LineSceneProxy->AppendMeshSectionLines(Section, Points.Num(), MaxLines);
+
+    MarkRenderTransformDirty();
+}
+
+void ULineRendererComponent::UpdateLinePoints(int32 SectionIndex, int32 StartIndex, const TArray<FVector>& Points)
+{
+    LINE_RENDERER_SCOPE_CYCLE_COUNTER(STAT_LineRenderer_StoreSections);
+
+    FLineSectionInfo* Section = Sections.Find(SectionIndex);
+    if (Section == nullptr || StartIndex < 0 || StartIndex >= Section->GetNumPoints())
+    {
+        return;
+    }
+
+    const int32 NumPoints = FMath::Min(Points.Num(), Section->GetNumPoints() - StartIndex);
+
+    // Points of the box sides before the update, only moving one of them can shrink the box
+    const FBox InnerBox = Section->LocalBox.IsValid ? Section->LocalBox.ExpandBy(-Section->Thickness) : FBox(ForceInit);
+    bool bMovedBoxSide = false;
+
+    for (int32 PointIndex = 0; PointIndex < NumPoints; ++PointIndex)
+    {
+        FVector3f& Point = Section->Points[Section->FirstPoint + StartIndex + PointIndex];
+
+        bMovedBoxSide |= IsOnBoxSide(InnerBox, Point);
+        Point = FVector3f(Points[PointIndex]);
+    }
+
+    if (bMovedBoxSide)
+    {
+        Section->LocalBox = CalcPointsBox(Section->GetPoints(), Section->Thickness);
+        UpdateLocalLinesBox();
+    }
+    else
+    {
+        // Grows only, the points left on the sides keep it tight
+        Section->LocalBox += CalcPointsBox(Section->GetPoints().Slice(StartIndex, NumPoints), Section->Thickness);
+        LocalLinesBox += Section->LocalBox;
+    }
+
+    FLineRendererComponentSceneProxy* LineSceneProxy = (FLineRendererComponentSceneProxy*)SceneProxy;
+    if (LineSceneProxy == nullptr || ChangesStaticSections(MakeArrayView(&SectionIndex, 1)))
+    {
+        MarkRenderStateDirty();
+        return;
+    }
+
+    LineSceneProxy->UpdateMeshSectionPoints(SectionIndex, StartIndex, MakeArrayView(Points.GetData(), NumPoints));
+
+    MarkRenderTransformDirty();
+}
+
+void ULineRendererComponent::RemoveLine(int32 SectionIndex)
+{
+    RemoveLines({ SectionIndex });
+}
+
+void ULineRendererComponent::RemoveLines(const TArray<int32>& SectionIndices)
+{
+    for (int32 SectionIndex : SectionIndices)
+    {
+        Sections.Remove(SectionIndex);
+    }
+
+    UpdateLocalLinesBox();
+
+    FLineRendererComponentSceneProxy* LineSceneProxy = (FLineRendererComponentSceneProxy*)SceneProxy;
+    if (LineSceneProxy == nullptr)
+    {
+        return;
+    }
+
+    if (ChangesStaticSections(SectionIndices))
+    {
+        MarkRenderStateDirty();
+        return;
+    }
+
+    LineSceneProxy->ClearMeshSections(SectionIndices);
+
+    MarkRenderTransformDirty();
+}
+
+void ULineRendererComponent::RemoveAllLines()
+{
+    // Lines stored while there was no proxy are removed as well
+    Sections.Empty();
+    LocalLinesBox = FBox(ForceInit);
+
+	FLineRendererComponentSceneProxy* LineSceneProxy = (FLineRendererComponentSceneProxy*)SceneProxy;
+    if (LineSceneProxy == nullptr)
+    {
+        return;
+    }
+
+    // Without sections the render state has no proxy, cached static draws go with the old one
+    if (LineSceneProxy->HasStaticSections())
+    {
+        MarkRenderStateDirty();
+        return;
+    }
+
+    LineSceneProxy->ClearAllMeshSections();
+}
+
+void ULineRendererComponent::SetLineVisible(int32 SectionIndex, bool bNewVisibility)
+{
+    if (FLineSectionInfo* Section = Sections.Find(SectionIndex))
+    {
+        Section->bVisible = bNewVisibility;
+    }
+
+	FLineRendererComponentSceneProxy* LineSceneProxy = (FLineRendererComponentSceneProxy*)SceneProxy;
+    if (LineSceneProxy == nullptr)
+    {
+        return;
+    }
+
+    // The new proxy picks the visibility up from the section
+    if (ChangesStaticSections(MakeArrayView(&SectionIndex, 1)))
+    {
+        MarkRenderStateDirty();
+        return;
+    }
+
+    LineSceneProxy->SetMeshSectionVisible(SectionIndex, bNewVisibility);
+}
+
+bool ULineRendererComponent::IsLineVisible(int32 SectionIndex) const
+{
+    // Sections of the game thread, the proxy ones belong to the render thread
+    const FLineSectionInfo* Section = Sections.Find(SectionIndex);
+
+    return Section != nullptr && Section->bVisible;
+}
+
+int32 ULineRendererComponent::GetNumSections() const
+{
+    return Sections.Num();
+}
+
+int32 ULineRendererComponent::GetNumPointsInSection(int32 SectionIndex) const
+{
+    const FLineSectionInfo* Section = Sections.Find(SectionIndex);
+
+    return Section != nullptr ? Section->GetNumPoints() : 0;
+}
+
+FLineSectionMemoryStats ULineRendererComponent::GetLineMemoryStats(TMap<int32, FLineSectionMemoryStats>* OutSectionStats) const
+{
+    const FLineRendererComponentSceneProxy* LineSceneProxy = (const FLineRendererComponentSceneProxy*)SceneProxy;
+
+    FLineSectionMemoryStats ComponentStats;
+
+    for (const FLineSectionInfo& Section : Sections)
+    {
+        FLineSectionMemoryStats Stats;
+
+        // Render resources and packed lines of the proxy, simplified levels included
+        if (LineSceneProxy != nullptr)
+        {
+            LineSceneProxy->GetSectionMemoryStats(Section.SectionIndex, Stats);
+        }
+
+        Stats.LineBytes += Section.Points.GetAllocatedSize();
+
+        if (OutSectionStats != nullptr)
+        {
+            OutSectionStats->Add(Section.SectionIndex, Stats);
+        }
+
+        ComponentStats += Stats;
+    }
+
+    return ComponentStats;
+}
+
+void ULineRendererComponent::GetResourceSizeEx(FResourceSizeEx& CumulativeResourceSize)
+{
+    Super::GetResourceSizeEx(CumulativeResourceSize);
+
+    const FLineSectionMemoryStats Stats = GetLineMemoryStats();
+
+    CumulativeResourceSize.AddDedicatedSystemMemoryBytes(Sections.GetAllocatedSize() + Stats.LineBytes);
+    CumulativeResourceSize.AddDedicatedVideoMemoryBytes(Stats.GetGPUBytes());
+}
+
+void ULineRendererComponent::AddReferencedObjects(UObject* InThis, FReferenceCollector& Collector)
+{
+    ULineRendererComponent* This = CastChecked<ULineRendererComponent>(InThis);
+
+    for (FLineSectionInfo& Section : This->Sections)
+    {
+        Collector.AddReferencedObject(Section.Material, This);
+    }
+
+    Super::AddReferencedObjects(InThis, Collector);
+}
+
+FPrimitiveSceneProxy* ULineRendererComponent::CreateSceneProxy()
+{
+    if (Sections.Num() > 0)
+    {
+        return new FLineRendererComponentSceneProxy(this);
+    }
+
+    return nullptr;
+}
+
+UMaterialInterface* ULineRendererComponent::GetMaterial(int32 ElementIndex) const
+{
+    if (const FLineSectionInfo* Section = Sections.Find(ElementIndex))
+    {
+        return Section->Material;
+    }
+
+    return nullptr;
+}
+
+FMaterialRelevance ULineRendererComponent::GetMaterialRelevance(ERHIFeatureLevel::Type InFeatureLevel) const
+{
+    if (IsValid(LineMaterial))
+    {
+        return LineMaterial->GetRelevance_Concurrent(InFeatureLevel);
+    }
+    return FMaterialRelevance();
+}
+
+void ULineRendererComponent::GetUsedMaterials(TArray<UMaterialInterface*>& OutMaterials, bool bGetDebugMaterials /*= false*/) const
+{
+    Super::GetUsedMaterials(OutMaterials, bGetDebugMaterials);
+
+    OutMaterials.Add(LineMaterial);
+
+    for (const FLineSectionInfo& Section : Sections)
+    {
+        if (Section.Material != LineMaterial)
+        {
+            OutMaterials.Add(Section.Material);
+        }
+    }
+}
+
+UMaterialInterface* ULineRendererComponent::CreateOrUpdateMaterial(int32 SectionIndex, const FLinearColor& Color)
+{
+    UMaterialInstanceDynamic* MI = nullptr;
+
+    // A section created again keeps its material instance
+    if (const FLineSectionInfo* ExistingSection = Sections.Find(SectionIndex))
+    {
+        if (ExistingSection->Material != LineMaterial)
+        {
+            MI = Cast<UMaterialInstanceDynamic>(ExistingSection->Material);
+        }
+    }
+
+    if (MI == nullptr)
+    {
+        MI = UMaterialInstanceDynamic::Create(LineMaterial, this);
+    }
+
+    MI->SetVectorParameterValue(TEXT("LineColor"), Color);
+
+    return MI;
+}
+
+void ULineRendererComponent::UpdateLocalLinesBox()
+{
+    LINE_RENDERER_SCOPE_CYCLE_COUNTER(STAT_LineRenderer_Bounds);
+
+    LocalLinesBox = FBox(ForceInit);
+
+    for (const FLineSectionInfo& Section : Sections)
+    {
+        LocalLinesBox += Section.LocalBox;
+    }
+}
+
+FBoxSphereBounds ULineRendererComponent::CalcBounds(const FTransform& LocalToWorld) const
+{
+    LINE_RENDERER_SCOPE_CYCLE_COUNTER(STAT_LineRenderer_Bounds);
+
+    FBoxSphereBounds LocalBounds(FVector(0, 0, 0), FVector(0, 0, 0), 0);
+
+    // Sections keep their own boxes up to date, transform changes do not visit the lines
+    if (LocalLinesBox.IsValid)
+    {
+        LocalBounds = LocalBounds + FBoxSphereBounds(LocalLinesBox);
+    }
+
+    FBoxSphereBounds Ret(FBoxSphereBounds(LocalBounds).TransformBy(LocalToWorld));
+
+    Ret.BoxExtent *= BoundsScale;
+    Ret.SphereRadius *= BoundsScale;
+
+    return Ret;
+}
+
+void ULineRendererComponent::UpdateBounds()
+{
+    Bounds = CalcBounds(FTransform(GetRenderMatrix()));
+}
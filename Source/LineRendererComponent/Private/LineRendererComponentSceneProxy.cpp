@@ -1,665 +1,2457 @@
-// Copyright 2023 Petr Leontev. All Rights Reserved.
-
-#include "LineRendererComponentSceneProxy.h"
-#include "MaterialShared.h"
-#include "Rendering/PositionVertexBuffer.h"
-#include "LocalVertexFactory.h"
-#include "ShaderCore.h"
-#include "ShowFlags.h"
-#include "SceneInterface.h"
-#include "Runtime/Launch/Resources/Version.h"
-#include "LineRendererComponent.h"
-#include "LineSectionInfo.h"
-
-
-class FPositionOnlyVertexData :
-    public TStaticMeshVertexData<FPositionVertex>
-{
-public:
-    FPositionOnlyVertexData()
-        : TStaticMeshVertexData<FPositionVertex>(false)
-    {}
-
-    ~FPositionOnlyVertexData()
-    {}
-};
-
-/** A vertex buffer for lines. */
-class FDynamicPositionVertexBuffer : public FVertexBuffer
-{
-public:
-
-    /** Default constructor. */
-    FDynamicPositionVertexBuffer()
-        : NumVertices(0)
-    {}
-
-    FDynamicPositionVertexBuffer(int32 InNumVertices)
-        : NumVertices(InNumVertices)
-    {
-        VertexData = MakeUnique<FPositionOnlyVertexData>();
-        VertexData->ResizeBuffer(NumVertices);
-
-        Stride = VertexData->GetStride();
-    }
-
-    /** Destructor. */
-    ~FDynamicPositionVertexBuffer()
-    {
-        if (VertexData)
-        {
-            VertexData.Reset();
-        }
-    }
-
-    // FRenderResource interface.
-#if ENGINE_MAJOR_VERSION >= 4 && ENGINE_MINOR_VERSION > 2
-    virtual void InitRHI(FRHICommandListBase& RHICmdList) override
-#else
-    virtual void InitRHI() override
-#endif
-    {
-        // create dynamic buffer
-
-        // FRHIResourceCreateInfo CreateInfo(TEXT("ThickLines"), VertexData->GetResourceArray());
-        FRHIResourceCreateInfo CreateInfo(TEXT("ThickLines"));
-
-        check (VertexData.IsValid());
-
-        const uint32 SizeInBytes = NumVertices * sizeof(FVector3f) * 8 * 3;
-
-        check (SizeInBytes >= 0);
-
-#if ENGINE_MAJOR_VERSION > 4 && ENGINE_MINOR_VERSION > 2
-        VertexBufferRHI = RHICmdList.CreateVertexBuffer(SizeInBytes, EBufferUsageFlags::Dynamic | EBufferUsageFlags::ShaderResource, CreateInfo);
-        if (VertexBufferRHI)
-        {
-            PositionComponentSRV = RHICmdList.CreateShaderResourceView(FShaderResourceViewInitializer(VertexBufferRHI, PF_R32_FLOAT));
-        }
-        
-#else
-        VertexBufferRHI = RHICreateVertexBuffer(SizeInBytes, BUF_Dynamic | BUF_ShaderResource, CreateInfo);
-        if (VertexBufferRHI)
-        {
-            PositionComponentSRV = RHICreateShaderResourceView(FShaderResourceViewInitializer(VertexBufferRHI, PF_R32_FLOAT));
-        }
-#endif
-    }
-
-    virtual void ReleaseRHI() override
-    {
-        PositionComponentSRV.SafeRelease();
-        FVertexBuffer::ReleaseRHI();
-    }
-
-    void BindPositionVertexBuffer(const class FVertexFactory* VertexFactory, struct FStaticMeshDataType& StaticMeshData) const
-    {
-        StaticMeshData.PositionComponent = FVertexStreamComponent(
-            this,
-            STRUCT_OFFSET(FPositionVertex, Position),
-            GetStride(),
-            VET_Float3
-        );
-        StaticMeshData.PositionComponentSRV = PositionComponentSRV;
-    }
-
-    // Vertex data accessors.
-    FORCEINLINE FVector3f& VertexPosition(int32 VertexIndex)
-    {
-        check(VertexIndex < NumVertices);
-        return ((FPositionVertex*)(VertexData->GetDataPointer() + VertexIndex * Stride))->Position;
-    }
-
-    // Vertex data accessors.
-    FORCEINLINE const FVector3f& VertexPosition(int32 VertexIndex) const 
-    {
-        check(VertexIndex < NumVertices);
-        return ((FPositionVertex*)(VertexData->GetDataPointer() + VertexIndex * Stride))->Position;
-    }
-
-    void* GetVertexData() { return VertexData->GetDataPointer(); }
-
-    int32 GetStride() const
-    {
-        return Stride;
-    }
-
-    int32 GetNumVertices() const
-    {
-        return NumVertices;
-    }
-
-private:
-    int32 NumVertices;
-
-    int32 Stride = 0;
-
-    /** The vertex data storage type */
-    TUniquePtr<class FPositionOnlyVertexData> VertexData;
-
-    FShaderResourceViewRHIRef PositionComponentSRV;
-};
-
-class FLineProxySection : public TSharedFromThis<FLineProxySection>
-{
-public:
-    FLineProxySection(ERHIFeatureLevel::Type InFeatureLevel)
-        : VertexFactory(InFeatureLevel, "FLineProxySection")
-        , bSectionVisible(true)
-        , bInitialized(false)
-    {}
-
-    virtual ~FLineProxySection()
-    {
-        PositionVB->ReleaseResource();
-        delete PositionVB;
-        IndexBuffer.ReleaseResource();
-
-        // Using LocalVertexFactory requires to deinit all buffers
-        StaticMeshVertexBuffer.ReleaseResource();
-        // ColorVertexBuffer.ReleaseResource();
-        
-        VertexFactory.ReleaseResource();
-    }
-
-public:
-    TArray<FBatchedLine> Lines;
-
-    /** Position only vertex buffer */
-    FDynamicPositionVertexBuffer* PositionVB;
-    /** Index buffer for this section */
-    FRawStaticIndexBuffer IndexBuffer;
-
-    /** The buffer containing vertex data (UVs and tangents) */
-    FStaticMeshVertexBuffer StaticMeshVertexBuffer;
-    /** The buffer containing the vertex color data. */
-    // FColorVertexBuffer ColorVertexBuffer;
-
-    /** Vertex factory for this section */
-    FLocalVertexFactory VertexFactory;
-    /** Whether this section is currently visible */
-    bool bSectionVisible;
-    /** Section bounding box */
-    FBox3f SectionLocalBox;
-    /** Whether this section is initialized i.e. render resources created */
-    bool bInitialized;
-    /** Max vertex index */
-    int32 MaxVertexIndex;
-    /** Section index */
-    int32 SectionIndex;
-    /** Section thickness */
-    float SectionThickness;
-    /** Screenspace line drawing */
-    bool bScreenSpace;
-
-    // Customization
-    /** Material applied to this section */
-    class UMaterialInterface* Material;
-    /** Color applied to this section */
-    FLinearColor Color;
-};
-
-FLineRendererComponentSceneProxy::FLineRendererComponentSceneProxy(ULineRendererComponent* InComponent)
-: FPrimitiveSceneProxy(InComponent), Component(InComponent), MaterialRelevance(Component->GetMaterialRelevance(GetScene().GetFeatureLevel()))
-{
-    for (const auto& SectionKeyPair : Component->Sections)
-    {
-        AddNewSection_GameThread(&SectionKeyPair.Value);
-    }
-}
-
-
-FLineRendererComponentSceneProxy::~FLineRendererComponentSceneProxy()
-{
-    Sections_RenderThread.Empty();
-}
-
-SIZE_T FLineRendererComponentSceneProxy::GetTypeHash() const
-{
-    static size_t UniquePointer;
-    return reinterpret_cast<size_t>(&UniquePointer);
-}
-
-void FLineRendererComponentSceneProxy::GetDynamicMeshElements(const TArray<const FSceneView*>& Views, const FSceneViewFamily& ViewFamily, uint32 VisibilityMap, FMeshElementCollector& Collector) const
-{
-    // SCOPE_CYCLE_COUNTER(STAT_ProcMesh_GetMeshElements);
-
-    const FEngineShowFlags& EngineShowFlags = ViewFamily.EngineShowFlags;
-
-    const bool bIsWireframeView = AllowDebugViewmodes() && EngineShowFlags.Wireframe;
-
-    // Iterate over sections
-
-    for (const TTuple<int32, TSharedPtr<FLineProxySection>>& KeyValueIter : Sections_RenderThread)
-    {
-        TSharedPtr<FLineProxySection> Section = KeyValueIter.Value;
-
-        if (Section.IsValid() && Section->bInitialized && Section->bSectionVisible)
-        {
-            FMaterialRenderProxy* MaterialProxy = Section->Material->GetRenderProxy();
-
-            // For each view..
-            for (int32 ViewIndex = 0; ViewIndex < Views.Num(); ViewIndex++)
-            {
-                if (VisibilityMap & (1 << ViewIndex))
-                {
-                    const FSceneView* View = Views[ViewIndex];
-
-                    float OrthoZoomFactor = 1.0f;
-
-                    const bool bIsPerspective = View->ViewMatrices.GetProjectionMatrix().M[3][3] < 1.0f ? true : false;
-                    if (!bIsPerspective)
-                    {
-                        OrthoZoomFactor = 1.0f / View->ViewMatrices.GetProjectionMatrix().M[0][0];
-                    }
-
-                    // Draw the mesh.
-                    FMeshBatch& Mesh = Collector.AllocateMesh();
-                    Mesh.VertexFactory = &Section->VertexFactory;
-                    Mesh.MaterialRenderProxy = MaterialProxy;
-                    Mesh.ReverseCulling = !IsLocalToWorldDeterminantNegative();
-                    Mesh.Type = PT_TriangleList;
-                    Mesh.DepthPriorityGroup = SDPG_World;
-                    Mesh.bCanApplyViewModeOverrides = false;
-
-                    if (AllowDebugViewmodes() && bIsWireframeView)
-                    {
-                        Mesh.bWireframe = true;
-                    }
-
-                    const FMatrix& WorldToClip = View->ViewMatrices.GetViewProjectionMatrix();
-                    const FMatrix& ClipToWorld = View->ViewMatrices.GetInvViewProjectionMatrix();
-                    const uint32 ViewportSizeX = View->UnscaledViewRect.Width();
-                    const uint32 ViewportSizeY = View->UnscaledViewRect.Height();
-
-                    FVector CameraX = ClipToWorld.TransformVector(FVector(1, 0, 0)).GetSafeNormal();
-                    FVector CameraY = ClipToWorld.TransformVector(FVector(0, 1, 0)).GetSafeNormal();
-                    FVector CameraZ = ClipToWorld.TransformVector(FVector(0, 0, 1)).GetSafeNormal();
-
-                    const int32 VertexBufferRHIBytes = Section->PositionVB->VertexBufferRHI->GetSize();
-
-                    FBufferRHIRef VertexBufferRHI = Section->PositionVB->VertexBufferRHI;
-
-#if ENGINE_MAJOR_VERSION > 4 && ENGINE_MINOR_VERSION > 3
-                    FVector3f* ThickVertices = (FVector3f*)Collector.GetRHICommandList().LockBuffer(VertexBufferRHI, 0, VertexBufferRHIBytes, RLM_WriteOnly);
-#else
-                    FVector3f* ThickVertices = (FVector3f*)RHILockBuffer(VertexBufferRHI, 0, VertexBufferRHIBytes, RLM_WriteOnly);
-#endif
-
-                    check(ThickVertices);
-
-                    for (const FBatchedLine& Line : Section->Lines)
-                    {
-                        const float Thickness = Line.Thickness;
-
-                        const float StartW = WorldToClip.TransformFVector4(Line.Start).W;
-                        const float EndW = WorldToClip.TransformFVector4(Line.End).W;
-
-                        FVector4 StartClip = WorldToClip.TransformFVector4(Line.Start);
-                        FVector4 EndClip = WorldToClip.TransformFVector4(Line.End);
-
-                        const float ScalingStart = Section->bScreenSpace ? StartW / ViewportSizeX : 1.0;
-                        const float ScalingEnd = Section->bScreenSpace ? EndW / ViewportSizeX : 1.0;
-
-                        const float CurrentOrthoZoomFactor = Section->bScreenSpace ? OrthoZoomFactor : 1.0;
-                        const float ScreenSpaceScaling = Section->bScreenSpace ? 2.0 : 1.0;
-
-                        const float StartThickness = Thickness * ScreenSpaceScaling * CurrentOrthoZoomFactor * ScalingStart;
-                        const float EndThickness = Thickness * ScreenSpaceScaling * CurrentOrthoZoomFactor * ScalingEnd;
-
-                        const FVector WorldPointXS = CameraX * StartThickness * 0.5f;
-                        const FVector WorldPointYS = CameraY * StartThickness * 0.5f;
-
-                        const FVector WorldPointXE = CameraX * EndThickness * 0.5f;
-                        const FVector WorldPointYE = CameraY * EndThickness * 0.5f;
-
-                        // Generate vertices for the point such that the post-transform point size is constant.
-                        const FVector WorldPointX = CameraX * Thickness * StartW / ViewportSizeX;
-                        const FVector WorldPointY = CameraY * Thickness * StartW / ViewportSizeX;
-
-                        // Begin point
-                        ThickVertices[0] = FVector3f(Line.Start + WorldPointXS - WorldPointYS); // 0S
-                        ThickVertices[1] = FVector3f(Line.Start + WorldPointXS + WorldPointYS); // 1S
-                        ThickVertices[2] = FVector3f(Line.Start - WorldPointXS - WorldPointYS); // 2S
-
-                        ThickVertices[3] = FVector3f(Line.Start + WorldPointXS + WorldPointYS); // 1S
-                        ThickVertices[4] = FVector3f(Line.Start - WorldPointXS - WorldPointYS); // 2S
-                        ThickVertices[5] = FVector3f(Line.Start - WorldPointXS + WorldPointYS); // 3S
-
-                        // Ending point
-                        ThickVertices[0 + 6] = FVector3f(Line.End + WorldPointXE - WorldPointYE); // 0E
-                        ThickVertices[1 + 6] = FVector3f(Line.End + WorldPointXE + WorldPointYE); // 1E
-                        ThickVertices[2 + 6] = FVector3f(Line.End - WorldPointXE - WorldPointYE); // 2E
-
-                        ThickVertices[3 + 6] = FVector3f(Line.End + WorldPointXE + WorldPointYE); // 1E
-                        ThickVertices[4 + 6] = FVector3f(Line.End - WorldPointXE - WorldPointYE); // 2E
-                        ThickVertices[5 + 6] = FVector3f(Line.End - WorldPointXE + WorldPointYE); // 3E
-
-                        // First part of line
-                        ThickVertices[0 + 12] = FVector3f(Line.Start - WorldPointXS - WorldPointYS); // 2S
-                        ThickVertices[1 + 12] = FVector3f(Line.Start + WorldPointXS + WorldPointYS); // 1S
-                        ThickVertices[2 + 12] = FVector3f(Line.End - WorldPointXE - WorldPointYE); // 2E
-
-                        ThickVertices[3 + 12] = FVector3f(Line.Start + WorldPointXS + WorldPointYS); // 1S
-                        ThickVertices[4 + 12] = FVector3f(Line.End + WorldPointXE + WorldPointYE); // 1E
-                        ThickVertices[5 + 12] = FVector3f(Line.End - WorldPointXE - WorldPointYE); // 2E
-
-                        // Second part of line
-                        ThickVertices[0 + 18] = FVector3f(Line.Start - WorldPointXS + WorldPointYS); // 3S
-                        ThickVertices[1 + 18] = FVector3f(Line.Start + WorldPointXS - WorldPointYS); // 0S
-                        ThickVertices[2 + 18] = FVector3f(Line.End - WorldPointXE + WorldPointYE); // 3E
-
-                        ThickVertices[3 + 18] = FVector3f(Line.Start + WorldPointXS - WorldPointYS); // 0S
-                        ThickVertices[4 + 18] = FVector3f(Line.End + WorldPointXE - WorldPointYE); // 0E
-                        ThickVertices[5 + 18] = FVector3f(Line.End - WorldPointXE + WorldPointYE); // 3E
-
-                        ThickVertices += 24;
-                    }
-
-#if ENGINE_MAJOR_VERSION > 4 && ENGINE_MINOR_VERSION > 3
-                    Collector.GetRHICommandList().UnlockBuffer(VertexBufferRHI);
-#else
-                    RHIUnlockBuffer(VertexBufferRHI);
-#endif
-
-                    FMeshBatchElement& BatchElement = Mesh.Elements[0];
-                    BatchElement.IndexBuffer = &Section->IndexBuffer;
-
-                    bool bHasPrecomputedVolumetricLightmap;
-                    FMatrix PreviousLocalToWorld;
-                    int32 SingleCaptureIndex;
-                    bool bOutputVelocity;
-                    GetScene().GetPrimitiveUniformShaderParameters_RenderThread(GetPrimitiveSceneInfo(), bHasPrecomputedVolumetricLightmap, PreviousLocalToWorld, SingleCaptureIndex, bOutputVelocity);
-
-                    FDynamicPrimitiveUniformBuffer& DynamicPrimitiveUniformBuffer = Collector.AllocateOneFrameResource<FDynamicPrimitiveUniformBuffer>();
-
-#if ENGINE_MAJOR_VERSION > 4 && ENGINE_MINOR_VERSION > 3
-                    DynamicPrimitiveUniformBuffer.Set(Collector.GetRHICommandList(), GetLocalToWorld(), PreviousLocalToWorld, GetBounds(), GetLocalBounds(), true, bHasPrecomputedVolumetricLightmap, bOutputVelocity);
-#else
-                    DynamicPrimitiveUniformBuffer.Set(GetLocalToWorld(), PreviousLocalToWorld, GetBounds(), GetLocalBounds(), true, bHasPrecomputedVolumetricLightmap, bOutputVelocity);
-#endif
-                    BatchElement.PrimitiveUniformBufferResource = &DynamicPrimitiveUniformBuffer.UniformBuffer;
-
-                    BatchElement.FirstIndex = 0;
-                    BatchElement.NumPrimitives = Section->IndexBuffer.GetNumIndices() / 3;
-                    BatchElement.MinVertexIndex = 0;
-                    BatchElement.MaxVertexIndex = Section->MaxVertexIndex;
-
-#if ENABLE_DRAW_DEBUG
-                    BatchElement.VisualizeElementIndex = Section->SectionIndex;
-#endif
-
-                    // Draw bounds
-#if !(UE_BUILD_SHIPPING || UE_BUILD_TEST)
-                    if (bIsWireframeView)
-                    {
-                        RenderBounds(Collector.GetPDI(ViewIndex), EngineShowFlags, GetBounds(), IsSelected());
-                    }
-#endif
-                   
-                    Collector.AddMesh(ViewIndex, Mesh);
-                }
-            }
-        }
-    }
-}
-
-FPrimitiveViewRelevance FLineRendererComponentSceneProxy::GetViewRelevance(const FSceneView* View) const
-{
-    FPrimitiveViewRelevance Result;
-    Result.bDrawRelevance = IsShown(View);
-    Result.bShadowRelevance = IsShadowCast(View);
-    Result.bDynamicRelevance = true;
-    Result.bRenderInMainPass = ShouldRenderInMainPass();
-    Result.bUsesLightingChannels = GetLightingChannelMask() != GetDefaultLightingChannelMask();
-    Result.bRenderCustomDepth = ShouldRenderCustomDepth();
-    Result.bTranslucentSelfShadow = bCastVolumetricTranslucentShadow;
-    
-    Result.bVelocityRelevance = IsMovable() && Result.bOpaque && Result.bRenderInMainPass;
-
-    MaterialRelevance.SetPrimitiveViewRelevance(Result);
-
-    return Result;
-}
-
-void FLineRendererComponentSceneProxy::AddNewSection_GameThread(const FLineSectionInfo* SrcSection)
-{
-    check(IsInGameThread());
-
-    const int32 NumVerts = SrcSection->Lines.Num() * 8 * 3;
-
-    const int32 SrcSectionIndex = SrcSection->SectionIndex;
-
-    TSharedPtr<FLineProxySection> NewSection(MakeShareable(new FLineProxySection(GetScene().GetFeatureLevel())));
-    {
-        NewSection->Lines = SrcSection->Lines;
-        NewSection->MaxVertexIndex = NumVerts - 1;
-        NewSection->SectionIndex = SrcSectionIndex;
-        NewSection->Material = SrcSection->Material;
-        NewSection->Color = SrcSection->Color;
-        
-        NewSection->SectionLocalBox = FBox3f(EForceInit::ForceInitToZero);
-
-        NewSection->PositionVB = new FDynamicPositionVertexBuffer(NumVerts);
-
-        // Using LocalVertexFactory requires to init all buffers
-        NewSection->StaticMeshVertexBuffer.Init(NumVerts, 1, true);
-        // NewSection->ColorVertexBuffer.Init(NumVerts, true);
-
-        for (const FBatchedLine& Line : NewSection->Lines)
-        {
-            NewSection->SectionLocalBox += FVector3f(Line.Start);
-            NewSection->SectionLocalBox += FVector3f(Line.End);
-
-            // NO UV support just yet
-            FStaticMeshVertexBuffer& StaticMeshVB = NewSection->StaticMeshVertexBuffer;
-            
-            // Begin point
-            StaticMeshVB.SetVertexUV(0, 0, FVector2f(1, 0));
-            StaticMeshVB.SetVertexUV(1, 0, FVector2f(1, 1));
-            StaticMeshVB.SetVertexUV(2, 0, FVector2f(0, 0));
-
-            StaticMeshVB.SetVertexUV(3, 0, FVector2f(1, 1));
-            StaticMeshVB.SetVertexUV(4, 0, FVector2f(0, 0));
-            StaticMeshVB.SetVertexUV(5, 0, FVector2f(0, 1));
-
-            // Ending point
-            StaticMeshVB.SetVertexUV(6, 0, FVector2f(1, 0));
-            StaticMeshVB.SetVertexUV(7, 0, FVector2f(1, 1));
-            StaticMeshVB.SetVertexUV(8, 0, FVector2f(0, 0));
-
-            StaticMeshVB.SetVertexUV(9, 0, FVector2f(1, 1));
-            StaticMeshVB.SetVertexUV(10, 0, FVector2f(0, 0));
-            StaticMeshVB.SetVertexUV(11, 0, FVector2f(0, 1));
-            
-            // First part of line
-            StaticMeshVB.SetVertexUV(12, 0, FVector2f(0, 0));
-            StaticMeshVB.SetVertexUV(13, 0, FVector2f(1, 1));
-            StaticMeshVB.SetVertexUV(14, 0, FVector2f(0, 0));
-
-            StaticMeshVB.SetVertexUV(15, 0, FVector2f(1, 1));
-            StaticMeshVB.SetVertexUV(16, 0, FVector2f(1, 1));
-            StaticMeshVB.SetVertexUV(17, 0, FVector2f(0, 0));
-
-            // Second part of line
-            StaticMeshVB.SetVertexUV(18, 0, FVector2f(0, 1));
-            StaticMeshVB.SetVertexUV(19, 0, FVector2f(1, 0));
-            StaticMeshVB.SetVertexUV(20, 0, FVector2f(0, 1));
-
-            StaticMeshVB.SetVertexUV(21, 0, FVector2f(1, 0));
-            StaticMeshVB.SetVertexUV(22, 0, FVector2f(1, 0));
-            StaticMeshVB.SetVertexUV(23, 0, FVector2f(0, 1));
-
-            for (int32 Index = 0; Index < 24; ++Index)
-            {
-                StaticMeshVB.SetVertexTangents(Index, FVector3f::UpVector, FVector3f::RightVector, FVector3f::ForwardVector);
-            }
-            //*/
-        }
-
-        TArray<uint32> IndexBuffer;
-
-        int32 IndexOffset = 0;
-        for (int32 LineIndex = 0; LineIndex < NewSection->Lines.Num(); ++LineIndex)
-        {
-            // First rectangle
-            IndexBuffer.Add(IndexOffset + 0);
-            IndexBuffer.Add(IndexOffset + 1);
-            IndexBuffer.Add(IndexOffset + 2);
-
-            IndexBuffer.Add(IndexOffset + 3);
-            IndexBuffer.Add(IndexOffset + 4);
-            IndexBuffer.Add(IndexOffset + 5);
-
-            // Second rectangle
-            IndexBuffer.Add(IndexOffset + 6);
-            IndexBuffer.Add(IndexOffset + 7);
-            IndexBuffer.Add(IndexOffset + 8);
-
-            IndexBuffer.Add(IndexOffset + 9);
-            IndexBuffer.Add(IndexOffset + 10);
-            IndexBuffer.Add(IndexOffset + 11);
-
-            // Third rectangle
-            IndexBuffer.Add(IndexOffset + 12);
-            IndexBuffer.Add(IndexOffset + 13);
-            IndexBuffer.Add(IndexOffset + 14);
-
-            IndexBuffer.Add(IndexOffset + 15);
-            IndexBuffer.Add(IndexOffset + 16);
-            IndexBuffer.Add(IndexOffset + 17);
-
-            // Fourth rectangle
-            IndexBuffer.Add(IndexOffset + 18);
-            IndexBuffer.Add(IndexOffset + 19);
-            IndexBuffer.Add(IndexOffset + 20);
-
-            IndexBuffer.Add(IndexOffset + 21);
-            IndexBuffer.Add(IndexOffset + 22);
-            IndexBuffer.Add(IndexOffset + 23);
-
-            // Increment the IndexOffset for the next line
-            IndexOffset += 24;
-        }
-
-        NewSection->IndexBuffer.SetIndices(IndexBuffer, EIndexBufferStride::Force16Bit);
-
-        // Enqueue initialization of render resource
-        BeginInitResource(NewSection->PositionVB);
-        BeginInitResource(&NewSection->IndexBuffer);
-
-        // Using LocalVertexFactory requires to init all buffers
-        BeginInitResource(&NewSection->StaticMeshVertexBuffer);
-        // BeginInitResource(&NewSection->ColorVertexBuffer);
-    }
-
-    TSharedRef<FLineProxySection> SectionRef = StaticCastSharedRef<FLineProxySection>(NewSection.ToSharedRef());
-
-    ENQUEUE_RENDER_COMMAND(LineVertexBuffersInit)(
-        [this, SrcSectionIndex, SectionRef](FRHICommandListImmediate& RHICmdList)
-        {
-            FLocalVertexFactory::FDataType Data;
-
-            SectionRef->PositionVB->BindPositionVertexBuffer(&SectionRef->VertexFactory, Data);
-
-            // Using LocalVertexFactory requires to init all buffers
-            SectionRef->StaticMeshVertexBuffer.BindTangentVertexBuffer(&SectionRef->VertexFactory, Data);
-            SectionRef->StaticMeshVertexBuffer.BindPackedTexCoordVertexBuffer(&SectionRef->VertexFactory, Data);
-            SectionRef->StaticMeshVertexBuffer.BindLightMapVertexBuffer(&SectionRef->VertexFactory, Data, 1);
-
-            Data.LODLightmapDataIndex = 0;
-
-#if ENGINE_MAJOR_VERSION > 4 && ENGINE_MINOR_VERSION > 3
-            SectionRef->VertexFactory.SetData(RHICmdList, Data);
-            SectionRef->VertexFactory.InitResource(RHICmdList);
-
-#else
-            SectionRef->VertexFactory.SetData(Data);
-            SectionRef->VertexFactory.InitResource();
-#endif
-            
-
-#if WITH_EDITOR
-            TArray<UMaterialInterface*> UsedMaterials;
-            Component->GetUsedMaterials(UsedMaterials);
-
-            SetUsedMaterialForVerification(UsedMaterials);
-#endif
-
-
-            Sections_RenderThread.Add(SrcSectionIndex, SectionRef);
-
-            SectionRef->bInitialized = true;
-        }
-    );
-}
-
-bool FLineRendererComponentSceneProxy::CanBeOccluded() const
-{
-    return !MaterialRelevance.bDisableDepthTest;
-}
-
-uint32 FLineRendererComponentSceneProxy::GetMemoryFootprint() const
-{
-    return sizeof(*this) + GetAllocatedSize();
-}
-
-uint32 FLineRendererComponentSceneProxy::GetAllocatedSize() const
-{
-    return FPrimitiveSceneProxy::GetAllocatedSize();
-}
-
-int32 FLineRendererComponentSceneProxy::GetNumSections() const
-{
-    return Sections_RenderThread.Num();
-}
-
-int32 FLineRendererComponentSceneProxy::GetNumPointsInSection(int32 SectionIndex) const
-{
-    const TSharedPtr<FLineProxySection>& SectionRef = Sections_RenderThread.FindRef(SectionIndex);
-    if (SectionRef->PositionVB != nullptr)
-    {
-        return SectionRef->PositionVB->GetNumVertices();
-    }
-
-    return 0;
-}
-
-void FLineRendererComponentSceneProxy::ClearMeshSection(int32 SectionIndex)
-{
-    ENQUEUE_RENDER_COMMAND(ReleaseSectionResources)(
-        [this, SectionIndex](FRHICommandListImmediate&)
-        {
-            Sections_RenderThread.Remove(SectionIndex);
-        }
-    );
-}
-
-void FLineRendererComponentSceneProxy::ClearAllMeshSections()
-{
-    TArray<int32> SectionIndices;
-    Sections_RenderThread.GetKeys(SectionIndices);
-
-    for (int32 SectionIndex : SectionIndices)
-    {
-        ClearMeshSection(SectionIndex);
-    }
-}
-
-void FLineRendererComponentSceneProxy::SetMeshSectionVisible(int32 SectionIndex, bool bNewVisibility)
-{
-    ENQUEUE_RENDER_COMMAND(SetMeshSectionVisibility)(
-        [this, SectionIndex, bNewVisibility](FRHICommandListImmediate&)
-        {
-            if (Sections_RenderThread.Contains(SectionIndex))
-            {
-                Sections_RenderThread[SectionIndex]->bSectionVisible = bNewVisibility;
-            }
-        }
-    );
-}
-
-bool FLineRendererComponentSceneProxy::IsMeshSectionVisible(int32 SectionIndex) const
-{
-    return Sections_RenderThread.FindRef(SectionIndex)->bSectionVisible;
-}
+// Copyright 2023 Petr Leontev. All Rights Reserved.
+
+#include "LineRendererComponentSceneProxy.h"
+#include "MaterialShared.h"
+#include "Rendering/PositionVertexBuffer.h"
+#include "LocalVertexFactory.h"
+#include "ShaderCore.h"
+#include "ShowFlags.h"
+#include "SceneInterface.h"
+#include "HAL/IConsoleManager.h"
+#include "Runtime/Launch/Resources/Version.h"
+#include "LineRendererComponent.h"
+#include "LineSectionInfo.h"
+#include "LineRendererStats.h"
+#include "LineVertexExpansion.h"
+#include "LineVertexFactory.h"
+#include "LineTopologyBuffers.h"
+#include "LineSimplification.h"
+#include "Tasks/Task.h"
+#include "StereoRendering.h"
+#include "Misc/ScopeLock.h"
+
+static TAutoConsoleVariable<int32> CVarLineRendererExpansionCache(
+    TEXT("r.LineRenderer.ExpansionCache"),
+    1,
+    TEXT("Skip re-expanding line vertices when neither the view nor the section has changed since the last upload.\n")
+    TEXT(" 0: always expand\n")
+    TEXT(" 1: reuse cached expansion (default)"),
+    ECVF_RenderThreadSafe);
+
+static TAutoConsoleVariable<int32> CVarLineRendererMergeSections(
+    TEXT("r.LineRenderer.MergeSections"),
+    1,
+    TEXT("Draw sections sharing a material with a single mesh batch, GPU expanded sections with a single instanced draw.\n")
+    TEXT(" 0: one mesh batch per section\n")
+    TEXT(" 1: one mesh batch per material (default)"),
+    ECVF_RenderThreadSafe);
+
+static TAutoConsoleVariable<float> CVarLineRendererLODScreenError(
+    TEXT("r.LineRenderer.LODScreenError"),
+    1.0f,
+    TEXT("Largest error in pixels allowed when drawing a simplified level of a long polyline section.\n")
+    TEXT(" <= 0: always draw full resolution, no levels are built"),
+    ECVF_RenderThreadSafe);
+
+static TAutoConsoleVariable<int32> CVarLineRendererSectionCulling(
+    TEXT("r.LineRenderer.SectionCulling"),
+    1,
+    TEXT("Test the bounding box of every section against the frustum of each view, and shadow views, before expanding it.\n")
+    TEXT(" 0: draw every visible section in every view\n")
+    TEXT(" 1: skip sections outside of the view frustum (default)"),
+    ECVF_RenderThreadSafe);
+
+/** A vertex buffer for lines. Written by the expansion kernel only, no CPU copy is kept */
+class FDynamicPositionVertexBuffer : public FVertexBuffer
+{
+public:
+
+    /** Default constructor. */
+    FDynamicPositionVertexBuffer()
+        : NumVertices(0)
+    {}
+
+    FDynamicPositionVertexBuffer(int32 InNumVertices)
+        : NumVertices(InNumVertices)
+    {}
+
+    // FRenderResource interface.
+#if ENGINE_MAJOR_VERSION >= 4 && ENGINE_MINOR_VERSION > 2
+    virtual void InitRHI(FRHICommandListBase& RHICmdList) override
+#else
+    virtual void InitRHI() override
+#endif
+    {
+        // create dynamic buffer
+        FRHIResourceCreateInfo CreateInfo(TEXT("ThickLines"));
+
+        const uint32 SizeInBytes = GetSizeInBytes();
+
+#if ENGINE_MAJOR_VERSION > 4 && ENGINE_MINOR_VERSION > 2
+        VertexBufferRHI = RHICmdList.CreateVertexBuffer(SizeInBytes, EBufferUsageFlags::Dynamic | EBufferUsageFlags::ShaderResource, CreateInfo);
+        if (VertexBufferRHI)
+        {
+            PositionComponentSRV = RHICmdList.CreateShaderResourceView(FShaderResourceViewInitializer(VertexBufferRHI, PF_R32_FLOAT));
+        }
+        
+#else
+        VertexBufferRHI = RHICreateVertexBuffer(SizeInBytes, BUF_Dynamic | BUF_ShaderResource, CreateInfo);
+        if (VertexBufferRHI)
+        {
+            PositionComponentSRV = RHICreateShaderResourceView(FShaderResourceViewInitializer(VertexBufferRHI, PF_R32_FLOAT));
+        }
+#endif
+    }
+
+    virtual void ReleaseRHI() override
+    {
+        PositionComponentSRV.SafeRelease();
+        FVertexBuffer::ReleaseRHI();
+    }
+
+    void BindPositionVertexBuffer(const class FVertexFactory* VertexFactory, struct FStaticMeshDataType& StaticMeshData) const
+    {
+        StaticMeshData.PositionComponent = FVertexStreamComponent(
+            this,
+            STRUCT_OFFSET(FPositionVertex, Position),
+            GetStride(),
+            VET_Float3
+        );
+        StaticMeshData.PositionComponentSRV = PositionComponentSRV;
+    }
+
+    int32 GetStride() const
+    {
+        return sizeof(FPositionVertex);
+    }
+
+    int32 GetNumVertices() const
+    {
+        return NumVertices;
+    }
+
+    /** Size of the GPU buffer, never empty so that it can always be created */
+    uint32 GetSizeInBytes() const
+    {
+        return FMath::Max(NumVertices, 1) * GetStride();
+    }
+
+private:
+    int32 NumVertices;
+
+    FShaderResourceViewRHIRef PositionComponentSRV;
+};
+
+/** Appends VerticesPerLine copies of the color of every line */
+static void BuildLineVertexColors(TConstArrayView<FPackedLine> Lines, int32 VerticesPerLine, TArray<FColor>& OutColors)
+{
+    OutColors.Reserve(OutColors.Num() + Lines.Num() * VerticesPerLine);
+
+    for (const FPackedLine& Line : Lines)
+    {
+        const FColor Color = GetPackedLineColor(Line);
+
+        for (int32 VertexIndex = 0; VertexIndex < VerticesPerLine; ++VertexIndex)
+        {
+            OutColors.Add(Color);
+        }
+    }
+}
+
+/** Frames a view slot may go unused before its vertex buffer is released */
+static constexpr uint32 LineViewSlotMaxIdleFrames = 60;
+
+/** Positions expanded for one view and the vertex factory drawing them */
+class FLineViewSlot
+{
+public:
+    FLineViewSlot(ERHIFeatureLevel::Type InFeatureLevel)
+        : PositionVB(nullptr)
+        , VertexFactory(InFeatureLevel, "FLineViewSlot")
+        , LastUsedFrame(0)
+        , bExpansionCacheValid(false)
+        , CachedRevision(0)
+        , CachedLODIndex(0)
+    {}
+
+    ~FLineViewSlot()
+    {
+        if (PositionVB != nullptr)
+        {
+            PositionVB->ReleaseResource();
+            delete PositionVB;
+        }
+
+        VertexFactory.ReleaseResource();
+    }
+
+    /** Whether PositionVB holds the expansion of these lines for this view */
+    bool IsExpandedFor(uint32 Revision, int32 LODIndex, const FMatrix& ViewProjectionMatrix, const FIntPoint& ViewportSize) const
+    {
+        return bExpansionCacheValid
+            && CachedRevision == Revision
+            && CachedLODIndex == LODIndex
+            && CachedViewportSize == ViewportSize
+            && CachedViewProjectionMatrix == ViewProjectionMatrix;
+    }
+
+    void SetExpandedFor(uint32 Revision, int32 LODIndex, const FMatrix& ViewProjectionMatrix, const FIntPoint& ViewportSize)
+    {
+        bExpansionCacheValid = true;
+        CachedRevision = Revision;
+        CachedLODIndex = LODIndex;
+        CachedViewProjectionMatrix = ViewProjectionMatrix;
+        CachedViewportSize = ViewportSize;
+    }
+
+public:
+    /** Position only vertex buffer */
+    FDynamicPositionVertexBuffer* PositionVB;
+    /** Binds PositionVB and the buffers shared by all slots */
+    FLocalVertexFactory VertexFactory;
+    /** Frame this slot was last handed out in */
+    uint32 LastUsedFrame;
+
+    // Expansion cache
+    /** Whether PositionVB holds an expansion for the cached state below */
+    bool bExpansionCacheValid;
+    /** Revision of the lines PositionVB was expanded for */
+    uint32 CachedRevision;
+    /** Level PositionVB was expanded for */
+    int32 CachedLODIndex;
+    /** View projection matrix PositionVB was expanded for */
+    FMatrix CachedViewProjectionMatrix;
+    /** Viewport size PositionVB was expanded for */
+    FIntPoint CachedViewportSize;
+};
+
+/**
+ * Vertex buffers CPU expanded lines are written to, one per view of a frame.
+ * Views drawn in the same frame, including scene captures and shadow views, never share a slot:
+ * mesh batches of earlier views keep reading their own data. Slots are reused across frames,
+ * preferably by the view they were last expanded for so that the expansion cache still applies.
+ */
+class FLineViewSlotPool
+{
+public:
+    FLineViewSlotPool(ERHIFeatureLevel::Type InFeatureLevel)
+        : FeatureLevel(InFeatureLevel)
+        , NumVertices(0)
+    {}
+
+    /** Sets the buffers bound next to the positions. Slots too small for InNumVertices are dropped, the others are rebound */
+    void Reset(FRHICommandListBase& RHICmdList, const FLocalVertexFactory::FDataType& InVertexData, int32 InNumVertices)
+    {
+        // Grow geometrically so that sections added one by one do not reallocate every frame
+        if (InNumVertices > NumVertices)
+        {
+            NumVertices = FMath::Max(InNumVertices, NumVertices * 2);
+        }
+
+        VertexData = InVertexData;
+
+        for (int32 SlotIndex = Slots.Num() - 1; SlotIndex >= 0; --SlotIndex)
+        {
+            FLineViewSlot& Slot = *Slots[SlotIndex];
+
+            if (Slot.PositionVB->GetNumVertices() < NumVertices)
+            {
+                Slots.RemoveAtSwap(SlotIndex);
+                continue;
+            }
+
+            Slot.VertexFactory.ReleaseResource();
+            InitVertexFactory(RHICmdList, Slot);
+            Slot.bExpansionCacheValid = false;
+        }
+    }
+
+    /** Slot an earlier view of this frame expanded these lines into for the same view state, stereo eyes share it */
+    FLineViewSlot* FindExpandedThisFrame(uint32 FrameNumber, uint32 Revision, int32 LODIndex, const FMatrix& ViewProjectionMatrix, const FIntPoint& ViewportSize) const
+    {
+        for (const TUniquePtr<FLineViewSlot>& Slot : Slots)
+        {
+            if (Slot->LastUsedFrame == FrameNumber && Slot->IsExpandedFor(Revision, LODIndex, ViewProjectionMatrix, ViewportSize))
+            {
+                return Slot.Get();
+            }
+        }
+
+        return nullptr;
+    }
+
+    /** Hands out a slot no other view used in this frame, the one already expanded for this view if there is one */
+    FLineViewSlot& Acquire(FRHICommandListBase& RHICmdList, uint32 FrameNumber, uint32 Revision, int32 LODIndex, const FMatrix& ViewProjectionMatrix, const FIntPoint& ViewportSize)
+    {
+        FLineViewSlot* CachedSlot = nullptr;
+        FLineViewSlot* OldestSlot = nullptr;
+
+        for (int32 SlotIndex = Slots.Num() - 1; SlotIndex >= 0; --SlotIndex)
+        {
+            FLineViewSlot& Slot = *Slots[SlotIndex];
+
+            if (Slot.LastUsedFrame == FrameNumber)
+            {
+                continue;
+            }
+
+            // Slots of views that stopped rendering, e.g. a closed split screen, are released after a while
+            if (FrameNumber - Slot.LastUsedFrame > LineViewSlotMaxIdleFrames)
+            {
+                Slots.RemoveAtSwap(SlotIndex);
+                continue;
+            }
+
+            if (CachedSlot == nullptr && Slot.IsExpandedFor(Revision, LODIndex, ViewProjectionMatrix, ViewportSize))
+            {
+                CachedSlot = &Slot;
+            }
+
+            if (OldestSlot == nullptr || FrameNumber - Slot.LastUsedFrame > FrameNumber - OldestSlot->LastUsedFrame)
+            {
+                OldestSlot = &Slot;
+            }
+        }
+
+        FLineViewSlot* Slot = CachedSlot != nullptr ? CachedSlot : OldestSlot;
+
+        if (Slot == nullptr)
+        {
+            Slot = Slots.Add_GetRef(MakeUnique<FLineViewSlot>(FeatureLevel)).Get();
+            Slot->PositionVB = new FDynamicPositionVertexBuffer(NumVertices);
+
+#if ENGINE_MAJOR_VERSION > 4 && ENGINE_MINOR_VERSION > 3
+            Slot->PositionVB->InitResource(RHICmdList);
+#else
+            Slot->PositionVB->InitResource();
+#endif
+            InitVertexFactory(RHICmdList, *Slot);
+        }
+
+        Slot->LastUsedFrame = FrameNumber;
+
+        return *Slot;
+    }
+
+    /** Number of slots alive, about the number of views drawing the lines each frame */
+    int32 GetNumSlots() const
+    {
+        return Slots.Num();
+    }
+
+private:
+    void InitVertexFactory(FRHICommandListBase& RHICmdList, FLineViewSlot& Slot) const
+    {
+        FLocalVertexFactory::FDataType Data = VertexData;
+        Slot.PositionVB->BindPositionVertexBuffer(&Slot.VertexFactory, Data);
+
+#if ENGINE_MAJOR_VERSION > 4 && ENGINE_MINOR_VERSION > 3
+        Slot.VertexFactory.SetData(RHICmdList, Data);
+        Slot.VertexFactory.InitResource(RHICmdList);
+#else
+        Slot.VertexFactory.SetData(Data);
+        Slot.VertexFactory.InitResource();
+#endif
+    }
+
+private:
+    ERHIFeatureLevel::Type FeatureLevel;
+    /** Tangents, texture coordinates and colors, everything but the positions */
+    FLocalVertexFactory::FDataType VertexData;
+    /** Vertices of every slot */
+    int32 NumVertices;
+    TArray<TUniquePtr<FLineViewSlot>> Slots;
+};
+
+/** Simplified level of a section and the render resources drawing it */
+class FLineSectionLOD
+{
+public:
+    FLineSectionLOD(ERHIFeatureLevel::Type InFeatureLevel, FLineLOD&& InLOD)
+        : Lines(MoveTemp(InLOD.Lines))
+        , Error(InLOD.Error)
+        , LineVertexFactory(InFeatureLevel)
+    {}
+
+    ~FLineSectionLOD()
+    {
+        StripIndexBuffer.ReleaseResource();
+        LineVertexFactory.ReleaseResource();
+        SegmentBuffer.ReleaseResource();
+    }
+
+    /** Kept lines, drawn with the position and color buffers of the full resolution section */
+    TArray<FPackedLine> Lines;
+    /** Largest distance to the full resolution lines, in local units */
+    float Error;
+
+    /** Indices of strips expanded on the CPU */
+    FRawStaticIndexBuffer StripIndexBuffer;
+
+    /** Segment buffer and vertex factory of sections expanded on the GPU */
+    FLineSegmentBuffer SegmentBuffer;
+    FLineVertexFactory LineVertexFactory;
+
+    /** Memory allocated for this level */
+    FLineSectionMemoryStats Memory;
+};
+
+/** Packs the lines of a section from FirstLine on for the expansion kernel, the color is only kept for the vertex color stream */
+static void PackSectionLines(const FLineSectionInfo& SrcSection, int32 FirstLine, bool bVertexColor, TArray<FPackedLine>& OutLines)
+{
+    // Linear, so that VertexColor matches the LineColor parameter of the section material
+    const FColor Color = bVertexColor ? SrcSection.Color.ToFColor(false) : FColor::White;
+    const TConstArrayView<FVector3f> Points = SrcSection.GetPoints();
+
+    OutLines.Reserve(OutLines.Num() + SrcSection.GetNumLines() - FirstLine);
+
+    for (int32 LineIndex = FirstLine; LineIndex < SrcSection.GetNumLines(); ++LineIndex)
+    {
+        FPackedLine& Line = OutLines.AddDefaulted_GetRef();
+        Line.StartAndThickness = FVector4f(Points[LineIndex], SrcSection.Thickness);
+        Line.End = FVector4f(Points[LineIndex + 1], 0.0f);
+
+        SetPackedLineColor(Line, Color);
+    }
+}
+
+/** Lines built by one section build task, smaller batches are built on the game thread */
+static constexpr int32 LineSectionBuildTaskLines = 16384;
+
+/** Frames the lines of a section have to stay unchanged before its simplified levels are built again */
+static constexpr uint32 LineLODRebuildFrames = 30;
+
+/** Size of the strip indices BuildStripIndices writes for these lines, 16 bit while every vertex index fits */
+static SIZE_T GetStripIndexDataSize(TConstArrayView<FPackedLine> Lines)
+{
+    int32 NumIndices = 0;
+
+    for (int32 LineIndex = 0; LineIndex < Lines.Num(); ++LineIndex)
+    {
+        NumIndices += IsJoinedToPreviousLine(Lines, LineIndex) ? NumIndicesPerStripLine : NumIndicesPerRibbonLine;
+    }
+
+    const bool b32Bit = Lines.Num() * NumVerticesPerRibbonLine > MAX_uint16 + 1;
+    return NumIndices * (b32Bit ? sizeof(uint32) : sizeof(uint16));
+}
+
+class FLineProxySection
+{
+public:
+    FLineProxySection(ERHIFeatureLevel::Type InFeatureLevel)
+        : ViewSlots(InFeatureLevel)
+        , LineVertexFactory(InFeatureLevel)
+        , StaticVertexFactory(InFeatureLevel, "FLineProxySection")
+        , bGPUExpansion(false)
+        , bStaticDraw(false)
+        , bVertexColor(false)
+        , bSectionVisible(true)
+        , bInitialized(false)
+        , SectionThickness(0.0f)
+        , FirstLine(0)
+        , LineCapacity(0)
+        , NumStripIndices(0)
+        , bStreaming(false)
+        , ViewVisibilityMap(0)
+        , LODIndex(0)
+        , LODFrameNumber(MAX_uint32)
+        , bLODsStale(false)
+        , LinesChangedFrame(0)
+        , TopologyRevision(0)
+        , Revision(0)
+    {}
+
+    virtual ~FLineProxySection()
+    {
+        // Shared topology buffers are released with their last user
+        StripIndexBuffer.ReleaseResource();
+        ColorVertexBuffer.ReleaseResource();
+
+        LineVertexFactory.ReleaseResource();
+        SegmentBuffer.ReleaseResource();
+
+        StaticVertexFactory.ReleaseResource();
+        StaticPositionBuffer.ReleaseResource();
+    }
+
+public:
+    /** Line endpoints and thickness packed for the expansion kernel, see GetLines */
+    TArray<FPackedLine> Lines;
+
+    /** Shared index and UV/tangent buffers, this section uses their first vertices */
+    TSharedPtr<FLineTopologyBuffers> Topology;
+    /** Indices of strips, which depend on how the lines are joined */
+    FRawStaticIndexBuffer StripIndexBuffer;
+    /** Line colors, only filled when the component uses vertex colors */
+    FColorVertexBuffer ColorVertexBuffer;
+
+    /** Positions expanded on the CPU and their vertex factories, one per view */
+    FLineViewSlotPool ViewSlots;
+
+    /** Line endpoints read by the vertex shader when expanding on the GPU */
+    FLineSegmentBuffer SegmentBuffer;
+    /** Vertex factory expanding lines from vertex id */
+    FLineVertexFactory LineVertexFactory;
+
+    /** View independent tubes of static sections, see BuildStaticLineVertices */
+    FPositionVertexBuffer StaticPositionBuffer;
+    FLocalVertexFactory StaticVertexFactory;
+
+    /** Whether this section is expanded on the GPU instead of filling view slots */
+    bool bGPUExpansion;
+    /** Whether this section is built once and drawn from DrawStaticElements instead of GetDynamicMeshElements */
+    bool bStaticDraw;
+    /** Whether line colors are bound as vertex colors */
+    bool bVertexColor;
+
+    /** Whether this section is currently visible */
+    bool bSectionVisible;
+    /** Section bounding box */
+    FBox3f SectionLocalBox;
+    /** Whether this section is initialized i.e. render resources created */
+    bool bInitialized;
+    /** Max vertex index */
+    int32 MaxVertexIndex;
+    /** Section index */
+    int32 SectionIndex;
+    /** Handle of this section in Sections_RenderThread, a section replacing it under the same index gets another one */
+    FLineSectionHandle Handle;
+    /** Largest thickness of the lines of this section */
+    float SectionThickness;
+    /** Lines before this one were dropped by ring buffer appends, they are compacted away once they outnumber the others */
+    int32 FirstLine;
+    /** Number of lines the render resources have room for */
+    int32 LineCapacity;
+    /** Number of strip indices drawn, StripIndexBuffer may hold more for lines not appended yet */
+    int32 NumStripIndices;
+    /** Whether lines were appended, resources then have spare capacity and the segment buffer wraps around */
+    bool bStreaming;
+    /** Views of the current GetDynamicMeshElements call this section is drawn in */
+    uint32 ViewVisibilityMap;
+
+    // Level of detail
+    /** Builds the simplified levels on a worker thread, consumed by ResolveLODs */
+    UE::Tasks::TTask<TArray<FLineLOD>> LODTask;
+    /** Simplified levels from finest to coarsest, empty until LODTask completes */
+    TArray<TUniquePtr<FLineSectionLOD>> LODs;
+    /** Level drawn in the current frame, 0 is full resolution and N is LODs[N - 1] */
+    int32 LODIndex;
+    /** Frame LODIndex was selected in, every GetDynamicMeshElements call of a frame draws the same level */
+    uint32 LODFrameNumber;
+    /** Whether the lines changed since the simplified levels were built, see InvalidateLODs */
+    bool bLODsStale;
+    /** Render thread frame of the last change of the lines */
+    uint32 LinesChangedFrame;
+    /** Screenspace line drawing */
+    bool bScreenSpace;
+
+    // Customization
+    /** Material applied to this section */
+    class UMaterialInterface* Material;
+    /** Color applied to this section */
+    FLinearColor Color;
+
+    /** Incremented whenever lines are added or removed, point moves keep the topology */
+    uint32 TopologyRevision;
+    /** Incremented whenever the lines of this section change, view slots expanded for an older revision are stale */
+    uint32 Revision;
+
+    /** Memory allocated for this section */
+    FLineSectionMemoryStats Memory;
+
+public:
+    /** Lines of the section, without the ones dropped by ring buffer appends */
+    TConstArrayView<FPackedLine> GetLines() const
+    {
+        return TConstArrayView<FPackedLine>(Lines).RightChop(FirstLine);
+    }
+
+    /** Memory of the section and its simplified levels */
+    FLineSectionMemoryStats GetMemoryWithLODs() const
+    {
+        FLineSectionMemoryStats Total = Memory;
+
+        for (const TUniquePtr<FLineSectionLOD>& LOD : LODs)
+        {
+            Total += LOD->Memory;
+        }
+
+        return Total;
+    }
+
+    /** Lines of the level drawn in the current frame */
+    TConstArrayView<FPackedLine> GetDrawnLines() const
+    {
+        return LODIndex > 0 ? TConstArrayView<FPackedLine>(LODs[LODIndex - 1]->Lines) : GetLines();
+    }
+
+    /** Creates the render resources of the simplified levels once the worker thread is done with them, true if it did */
+    bool ResolveLODs(FRHICommandListBase& RHICmdList, ELineGeometryMode Mode)
+    {
+        if (!LODTask.IsValid() || !LODTask.IsCompleted())
+        {
+            return false;
+        }
+
+        for (FLineLOD& LOD : LODTask.GetResult())
+        {
+            FLineSectionLOD* SectionLOD = LODs.Add_GetRef(MakeUnique<FLineSectionLOD>(LineVertexFactory.GetFeatureLevel(), MoveTemp(LOD))).Get();
+            SectionLOD->Memory.LineBytes = SectionLOD->Lines.GetAllocatedSize();
+
+            if (bGPUExpansion)
+            {
+                SectionLOD->SegmentBuffer.Lines = SectionLOD->Lines;
+                SectionLOD->LineVertexFactory.SetSegmentBuffer(&SectionLOD->SegmentBuffer, bScreenSpace, Mode);
+                SectionLOD->Memory.VertexBytes = SectionLOD->SegmentBuffer.GetSizeInBytes();
+
+#if ENGINE_MAJOR_VERSION > 4 && ENGINE_MINOR_VERSION > 3
+                SectionLOD->SegmentBuffer.InitResource(RHICmdList);
+                SectionLOD->LineVertexFactory.InitResource(RHICmdList);
+#else
+                SectionLOD->SegmentBuffer.InitResource();
+                SectionLOD->LineVertexFactory.InitResource();
+#endif
+            }
+            else if (Mode == ELineGeometryMode::Strip)
+            {
+                TArray<uint32> Indices;
+                BuildStripIndices(SectionLOD->Lines, 0, Indices);
+
+                SectionLOD->StripIndexBuffer.SetIndices(Indices, EIndexBufferStride::AutoDetect);
+                SectionLOD->Memory.IndexBytes = SectionLOD->StripIndexBuffer.GetIndexDataSize();
+
+#if ENGINE_MAJOR_VERSION > 4 && ENGINE_MINOR_VERSION > 3
+                SectionLOD->StripIndexBuffer.InitResource(RHICmdList);
+#else
+                SectionLOD->StripIndexBuffer.InitResource();
+#endif
+            }
+        }
+
+        LODTask = {};
+
+        return true;
+    }
+
+    /** Drops the simplified levels of lines that just changed, the section is drawn at full resolution until RebuildStaleLODs replaces them */
+    void InvalidateLODs()
+    {
+        LODTask = {};
+        LODs.Reset();
+        LODIndex = 0;
+
+        bLODsStale = true;
+        LinesChangedFrame = GFrameNumberRenderThread;
+    }
+
+    /** Simplifies the lines again once they stopped changing for LineLODRebuildFrames, animated and streaming lines are not simplified every frame */
+    void RebuildStaleLODs()
+    {
+        if (!bLODsStale || GFrameNumberRenderThread - LinesChangedFrame < LineLODRebuildFrames)
+        {
+            return;
+        }
+
+        bLODsStale = false;
+
+        if (bStaticDraw || GetLines().Num() < LineLODMinLines)
+        {
+            return;
+        }
+
+        LODTask = UE::Tasks::Launch(UE_SOURCE_LOCATION, [Lines = TArray<FPackedLine>(GetLines())]()
+        {
+            LINE_RENDERER_SCOPE_CYCLE_COUNTER(STAT_LineRenderer_BuildLODs);
+
+            TArray<FLineLOD> LODs;
+            BuildLineLODs(Lines, LODs);
+            return LODs;
+        }, UE::Tasks::ETaskPriority::BackgroundNormal);
+    }
+};
+
+/** Maps the position buffer for the expansion kernel */
+static FVector3f* LockLineVertices(FRHICommandListBase& RHICmdList, FDynamicPositionVertexBuffer& PositionVB)
+{
+    LINE_RENDERER_SCOPE_CYCLE_COUNTER(STAT_LineRenderer_LockBuffers);
+
+    const int32 VertexBufferRHIBytes = PositionVB.VertexBufferRHI->GetSize();
+
+#if ENGINE_MAJOR_VERSION > 4 && ENGINE_MINOR_VERSION > 3
+    FVector3f* ThickVertices = (FVector3f*)RHICmdList.LockBuffer(PositionVB.VertexBufferRHI, 0, VertexBufferRHIBytes, RLM_WriteOnly);
+#else
+    FVector3f* ThickVertices = (FVector3f*)RHILockBuffer(PositionVB.VertexBufferRHI, 0, VertexBufferRHIBytes, RLM_WriteOnly);
+#endif
+
+    check(ThickVertices);
+
+    return ThickVertices;
+}
+
+static void UnlockLineVertices(FRHICommandListBase& RHICmdList, FDynamicPositionVertexBuffer& PositionVB)
+{
+    LINE_RENDERER_SCOPE_CYCLE_COUNTER(STAT_LineRenderer_LockBuffers);
+
+#if ENGINE_MAJOR_VERSION > 4 && ENGINE_MINOR_VERSION > 3
+    RHICmdList.UnlockBuffer(PositionVB.VertexBufferRHI);
+#else
+    RHIUnlockBuffer(PositionVB.VertexBufferRHI);
+#endif
+}
+
+/** Expands lines into a locked position buffer and counts the upload for stat LineRenderer */
+static void ExpandLinesToBuffer(const FLineExpansionView& View, bool bScreenSpace, ELineGeometryMode Mode, TConstArrayView<FPackedLine> Lines, FVector3f* OutVertices)
+{
+    LINE_RENDERER_SCOPE_CYCLE_COUNTER(STAT_LineRenderer_ExpandLines);
+
+    ExpandLineVertices(View, bScreenSpace, Mode, Lines, OutVertices);
+
+    const int32 NumVertices = Lines.Num() * GetNumVerticesPerLine(Mode);
+
+    INC_DWORD_STAT_BY(STAT_LineRenderer_SegmentsExpanded, Lines.Num());
+    INC_DWORD_STAT_BY(STAT_LineRenderer_VerticesUploaded, NumVertices);
+    INC_DWORD_STAT_BY(STAT_LineRenderer_BytesUploaded, NumVertices * sizeof(FVector3f));
+}
+
+/** Local box of the section grown by how far its expanded vertices can move away from the lines in this view */
+static FBox GetExpandedSectionBox(const FLineExpansionView& View, const FLineProxySection& Section)
+{
+    const FBox LocalBox(Section.SectionLocalBox);
+
+    float Margin = Section.SectionThickness;
+
+    if (Section.bScreenSpace)
+    {
+        // Thickness is in pixels, the farthest corner gets the widest offset
+        double MaxW = 0.0;
+
+        for (int32 CornerIndex = 0; CornerIndex < 8; ++CornerIndex)
+        {
+            const FVector Corner(
+                (CornerIndex & 1) ? LocalBox.Max.X : LocalBox.Min.X,
+                (CornerIndex & 2) ? LocalBox.Max.Y : LocalBox.Min.Y,
+                (CornerIndex & 4) ? LocalBox.Max.Z : LocalBox.Min.Z);
+
+            MaxW = FMath::Max(MaxW, View.ClipW.X * Corner.X + View.ClipW.Y * Corner.Y + View.ClipW.Z * Corner.Z + View.ClipW.W);
+        }
+
+        Margin *= 2.0f * View.OrthoZoomFactor * (float)MaxW / FMath::Max(View.ViewportSizeX, 1.0f);
+    }
+
+    return LocalBox.ExpandBy(Margin);
+}
+
+/** Whether the world space box intersects the frustum the view draws, shadow depth views provide the frustum of their casters */
+static bool IsBoxInViewFrustum(const FSceneView& View, const FBox& WorldBox)
+{
+    if (const FConvexVolume* ShadowCullFrustum = View.GetDynamicMeshElementsShadowCullFrustum())
+    {
+        return ShadowCullFrustum->IntersectBox(WorldBox.GetCenter() + View.GetPreShadowTranslation(), WorldBox.GetExtent());
+    }
+
+    return View.ViewFrustum.IntersectBox(WorldBox.GetCenter(), WorldBox.GetExtent());
+}
+
+/**
+ * Coarsest level of the section whose error stays under MaxScreenError pixels in every view the section is drawn in.
+ * Reads ViewVisibilityMap, which has to be culled for the current call first. Full resolution when no view draws the section
+ */
+static int32 SelectSectionLOD(const FLineProxySection& Section, const TArray<const FSceneView*>& Views, const FMatrix& LocalToWorld, float MaxScreenError)
+{
+    if (Section.LODs.Num() == 0 || MaxScreenError <= 0.0f)
+    {
+        return 0;
+    }
+
+    const FBox WorldBox = FBox(Section.SectionLocalBox).TransformBy(LocalToWorld);
+    const double LocalToWorldScale = FMath::Max(LocalToWorld.GetMaximumAxisScale(), UE_SMALL_NUMBER);
+
+    // Largest error allowed by all views, in local units
+    double MaxLocalError = TNumericLimits<double>::Max();
+
+    for (int32 ViewIndex = 0; ViewIndex < Views.Num(); ViewIndex++)
+    {
+        if (!(Section.ViewVisibilityMap & (1 << ViewIndex)))
+        {
+            continue;
+        }
+
+        const FSceneView* View = Views[ViewIndex];
+        const FMatrix& WorldToClip = View->ViewMatrices.GetViewProjectionMatrix();
+
+        // Clip W of the nearest corner, the view depth in perspective views and 1 in orthographic ones
+        double MinW = TNumericLimits<double>::Max();
+
+        for (int32 CornerIndex = 0; CornerIndex < 8; ++CornerIndex)
+        {
+            const FVector Corner(
+                (CornerIndex & 1) ? WorldBox.Max.X : WorldBox.Min.X,
+                (CornerIndex & 2) ? WorldBox.Max.Y : WorldBox.Min.Y,
+                (CornerIndex & 4) ? WorldBox.Max.Z : WorldBox.Min.Z);
+
+            MinW = FMath::Min(MinW, WorldToClip.TransformFVector4(FVector4(Corner, 1.0)).W);
+        }
+
+        // The section reaches the camera plane, only full resolution is safe
+        if (MinW <= UE_KINDA_SMALL_NUMBER)
+        {
+            return 0;
+        }
+
+        const double PixelsPerUnit = View->ViewMatrices.GetProjectionMatrix().M[0][0] * View->UnscaledViewRect.Width() * 0.5 / MinW;
+
+        MaxLocalError = FMath::Min(MaxLocalError, MaxScreenError / (PixelsPerUnit * LocalToWorldScale));
+    }
+
+    // No view of the current call draws the section, nothing bounds the error
+    if (MaxLocalError == TNumericLimits<double>::Max())
+    {
+        return 0;
+    }
+
+    for (int32 LODIndex = Section.LODs.Num(); LODIndex > 0; --LODIndex)
+    {
+        if (Section.LODs[LODIndex - 1]->Error <= MaxLocalError)
+        {
+            return LODIndex;
+        }
+    }
+
+    return 0;
+}
+
+/** Sections sharing a material, expanded back to back into one vertex buffer and drawn with one mesh batch */
+class FLineMergedBatch
+{
+public:
+    FLineMergedBatch(ERHIFeatureLevel::Type InFeatureLevel)
+        : ViewSlots(InFeatureLevel)
+        , NumLines(0)
+        , Revision(0)
+    {}
+
+    ~FLineMergedBatch()
+    {
+        StripIndexBuffer.ReleaseResource();
+        ColorVertexBuffer.ReleaseResource();
+    }
+
+    /** Whether the batch packs these sections at their current topology and level, only their points may have moved since */
+    bool HasSections(TConstArrayView<FLineProxySection*> InSections) const
+    {
+        if (SectionHandles.Num() != InSections.Num())
+        {
+            return false;
+        }
+
+        for (int32 Index = 0; Index < InSections.Num(); ++Index)
+        {
+            if (SectionHandles[Index] != InSections[Index]->Handle || SectionTopologyRevisions[Index] != InSections[Index]->TopologyRevision || SectionLODIndices[Index] != InSections[Index]->LODIndex)
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    /** Picks up moved points of the packed sections, they only invalidate the expansion */
+    void UpdateRevisions(TConstArrayView<FLineProxySection*> InSections)
+    {
+        for (int32 Index = 0; Index < InSections.Num(); ++Index)
+        {
+            if (SectionRevisions[Index] != InSections[Index]->Revision)
+            {
+                SectionRevisions[Index] = InSections[Index]->Revision;
+                ++Revision;
+            }
+        }
+    }
+
+    /**
+     * Packs the sections into this new batch. Batches are never rebuilt in place,
+     * meshes collected earlier in the frame keep drawing the batch they reference.
+     */
+    void SetSections(FRHICommandListBase& RHICmdList, TConstArrayView<FLineProxySection*> InSections, ELineGeometryMode Mode, bool bVertexColor)
+    {
+        LINE_RENDERER_SCOPE_CYCLE_COUNTER(STAT_LineRenderer_MergeBatches);
+
+        for (FLineProxySection* Section : InSections)
+        {
+            SectionHandles.Add(Section->Handle);
+            SectionTopologyRevisions.Add(Section->TopologyRevision);
+            SectionRevisions.Add(Section->Revision);
+            SectionLODIndices.Add(Section->LODIndex);
+            NumLines += Section->GetDrawnLines().Num();
+        }
+
+        Topology = FLineTopologyBuffers::Get(RHICmdList, Mode, NumLines);
+
+        if (Mode == ELineGeometryMode::Strip)
+        {
+            TArray<uint32> Indices;
+            uint32 BaseVertex = 0;
+
+            for (const FLineProxySection* Section : InSections)
+            {
+                BuildStripIndices(Section->GetDrawnLines(), BaseVertex, Indices);
+                BaseVertex += Section->GetDrawnLines().Num() * NumVerticesPerRibbonLine;
+            }
+
+            StripIndexBuffer.SetIndices(Indices, EIndexBufferStride::AutoDetect);
+
+#if ENGINE_MAJOR_VERSION > 4 && ENGINE_MINOR_VERSION > 3
+            StripIndexBuffer.InitResource(RHICmdList);
+#else
+            StripIndexBuffer.InitResource();
+#endif
+            INC_DWORD_STAT_BY(STAT_LineRenderer_BytesUploaded, StripIndexBuffer.GetIndexDataSize());
+        }
+
+        // Positions are bound per view slot
+        FLocalVertexFactory::FDataType Data;
+
+        if (bVertexColor)
+        {
+            TArray<FColor> Colors;
+
+            for (const FLineProxySection* Section : InSections)
+            {
+                BuildLineVertexColors(Section->GetDrawnLines(), GetNumVerticesPerLine(Mode), Colors);
+            }
+
+            ColorVertexBuffer.InitFromColorArray(Colors.GetData(), Colors.Num(), sizeof(FColor), false);
+
+#if ENGINE_MAJOR_VERSION > 4 && ENGINE_MINOR_VERSION > 3
+            ColorVertexBuffer.InitResource(RHICmdList);
+#else
+            ColorVertexBuffer.InitResource();
+#endif
+            INC_DWORD_STAT_BY(STAT_LineRenderer_BytesUploaded, Colors.Num() * sizeof(FColor));
+
+            ColorVertexBuffer.BindColorVertexBuffer(nullptr, Data);
+        }
+
+        // Using LocalVertexFactory requires to init all buffers
+        FStaticMeshVertexBuffer& StaticMeshVB = Topology->StaticMeshVertexBuffer;
+        StaticMeshVB.BindTangentVertexBuffer(nullptr, Data);
+        StaticMeshVB.BindPackedTexCoordVertexBuffer(nullptr, Data);
+        StaticMeshVB.BindLightMapVertexBuffer(nullptr, Data, 1);
+
+        Data.LODLightmapDataIndex = 0;
+
+        ViewSlots.Reset(RHICmdList, Data, NumLines * GetNumVerticesPerLine(Mode));
+
+        ++Revision;
+    }
+
+public:
+    /** Sections packed into this batch in draw order, their revisions and drawn levels at packing time */
+    TArray<FLineSectionHandle> SectionHandles;
+    TArray<uint32> SectionTopologyRevisions;
+    TArray<uint32> SectionRevisions;
+    TArray<int32> SectionLODIndices;
+
+    /** Shared index and UV/tangent buffers */
+    TSharedPtr<FLineTopologyBuffers> Topology;
+    /** Indices of all sections in strip mode */
+    FRawStaticIndexBuffer StripIndexBuffer;
+    /** Colors of all sections, empty without vertex colors */
+    FColorVertexBuffer ColorVertexBuffer;
+    /** Positions of all sections and the vertex factories of the merged draw, one per view */
+    FLineViewSlotPool ViewSlots;
+    /** Total number of lines of all sections */
+    int32 NumLines;
+    /** Incremented whenever the packed sections or their lines change */
+    uint32 Revision;
+};
+
+/**
+ * Sections expanded on the GPU sharing a material, their lines copied back to back into one segment buffer
+ * and drawn with one instanced draw. Screen space lines are flagged per line, see SetPackedLineScreenSpace
+ */
+class FLineInstancedBatch
+{
+public:
+    FLineInstancedBatch(ERHIFeatureLevel::Type InFeatureLevel)
+        : LineVertexFactory(InFeatureLevel)
+    {}
+
+    ~FLineInstancedBatch()
+    {
+        LineVertexFactory.ReleaseResource();
+        SegmentBuffer.ReleaseResource();
+    }
+
+    /** Whether the batch packs these sections at their current topology and level, only their points may have moved since */
+    bool HasSections(TConstArrayView<FLineProxySection*> InSections) const
+    {
+        if (SectionHandles.Num() != InSections.Num())
+        {
+            return false;
+        }
+
+        for (int32 Index = 0; Index < InSections.Num(); ++Index)
+        {
+            if (SectionHandles[Index] != InSections[Index]->Handle || SectionTopologyRevisions[Index] != InSections[Index]->TopologyRevision || SectionLODIndices[Index] != InSections[Index]->LODIndex)
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    /** Writes moved points of the packed sections in place, the lines keep their slots */
+    void UpdateLines(FRHICommandListBase& RHICmdList, TConstArrayView<FLineProxySection*> InSections)
+    {
+        bool bLinesChanged = false;
+
+        for (int32 Index = 0; Index < InSections.Num(); ++Index)
+        {
+            bLinesChanged |= SectionRevisions[Index] != InSections[Index]->Revision;
+            SectionRevisions[Index] = InSections[Index]->Revision;
+        }
+
+        if (!bLinesChanged)
+        {
+            return;
+        }
+
+        LINE_RENDERER_SCOPE_CYCLE_COUNTER(STAT_LineRenderer_MergeBatches);
+
+        Lines.Reset();
+        AppendSectionLines(InSections);
+
+        SegmentBuffer.Lines = Lines;
+        SegmentBuffer.WriteLines(RHICmdList, 0, Lines);
+    }
+
+    /**
+     * Packs the sections into the segment buffer of this new batch. Batches are never rebuilt in place,
+     * meshes collected earlier in the frame keep drawing the batch they reference.
+     */
+    void SetSections(FRHICommandListBase& RHICmdList, TConstArrayView<FLineProxySection*> InSections, ELineGeometryMode Mode)
+    {
+        LINE_RENDERER_SCOPE_CYCLE_COUNTER(STAT_LineRenderer_MergeBatches);
+
+        for (FLineProxySection* Section : InSections)
+        {
+            SectionHandles.Add(Section->Handle);
+            SectionTopologyRevisions.Add(Section->TopologyRevision);
+            SectionRevisions.Add(Section->Revision);
+            SectionLODIndices.Add(Section->LODIndex);
+        }
+
+        AppendSectionLines(InSections);
+
+        SegmentBuffer.Lines = Lines;
+        // Moved points of the sections are written in place by UpdateLines
+        SegmentBuffer.bDynamic = true;
+
+        // Screen space comes from each line
+        LineVertexFactory.SetSegmentBuffer(&SegmentBuffer, false, Mode);
+
+#if ENGINE_MAJOR_VERSION > 4 && ENGINE_MINOR_VERSION > 3
+        SegmentBuffer.InitResource(RHICmdList);
+        LineVertexFactory.InitResource(RHICmdList);
+#else
+        SegmentBuffer.InitResource();
+        LineVertexFactory.InitResource();
+#endif
+    }
+
+private:
+    void AppendSectionLines(TConstArrayView<FLineProxySection*> InSections)
+    {
+        for (FLineProxySection* Section : InSections)
+        {
+            const int32 FirstLine = Lines.Num();
+            Lines.Append(Section->GetDrawnLines());
+
+            if (Section->bScreenSpace)
+            {
+                for (int32 LineIndex = FirstLine; LineIndex < Lines.Num(); ++LineIndex)
+                {
+                    SetPackedLineScreenSpace(Lines[LineIndex]);
+                }
+            }
+        }
+    }
+
+public:
+    /** Sections packed into this batch in draw order, their revisions and drawn levels at packing time */
+    TArray<FLineSectionHandle> SectionHandles;
+    TArray<uint32> SectionTopologyRevisions;
+    TArray<uint32> SectionRevisions;
+    TArray<int32> SectionLODIndices;
+
+    /** Drawn lines of all sections, one instance each */
+    TArray<FPackedLine> Lines;
+    FLineSegmentBuffer SegmentBuffer;
+    FLineVertexFactory LineVertexFactory;
+};
+
+/** Keeps the batches referenced by the meshes of a GetDynamicMeshElements call alive until the frame is rendered */
+class FLineBatchFrameReferences : public FOneFrameResource
+{
+public:
+    TArray<TSharedPtr<FLineMergedBatch>> MergedBatches;
+    TArray<TSharedPtr<FLineInstancedBatch>> InstancedBatches;
+};
+
+FLineRendererComponentSceneProxy::FLineRendererComponentSceneProxy(ULineRendererComponent* InComponent)
+: FPrimitiveSceneProxy(InComponent), Component(InComponent), MaterialRelevance(Component->GetMaterialRelevance(GetScene().GetFeatureLevel()))
+, bGPUExpansion(InComponent->bGPUExpansion && FLineVertexFactory::IsSupported(GetScene().GetFeatureLevel()))
+, bVertexColor(InComponent->bVertexColor)
+, GeometryMode(InComponent->LineGeometryMode)
+, bStaticLines(InComponent->bStaticLines)
+, bHasStaticSections(false)
+, bHasDynamicSections_RenderThread(false)
+, SectionBuildMode(InComponent->SectionBuildMode)
+, LifetimeToken(MakeShared<bool, ESPMode::ThreadSafe>(true))
+{
+    TArray<const FLineSectionInfo*> SrcSections;
+    SrcSections.Reserve(Component->Sections.Num());
+
+    for (const FLineSectionInfo& Section : Component->Sections)
+    {
+        SrcSections.Add(&Section);
+    }
+
+    AddNewSections_GameThread(SrcSections);
+
+    // Static sections only come from here, changing one recreates the proxy
+    bHasStaticSections = StaticSections_GameThread.Num() > 0;
+}
+
+
+FLineRendererComponentSceneProxy::~FLineRendererComponentSceneProxy()
+{
+    LifetimeToken.Reset();
+
+    MergedBatches_RenderThread.Empty();
+    InstancedBatches_RenderThread.Empty();
+
+    // Build tasks write to the pending sections, they are released once the tasks are done
+    for (const FLinePendingSections& Pending : PendingSections_RenderThread)
+    {
+        UE::Tasks::Wait(Pending.BuildTasks);
+    }
+
+    PendingSections_RenderThread.Empty();
+    Sections_RenderThread.Empty();
+}
+
+SIZE_T FLineRendererComponentSceneProxy::GetTypeHash() const
+{
+    static size_t UniquePointer;
+    return reinterpret_cast<size_t>(&UniquePointer);
+}
+
+void FLineRendererComponentSceneProxy::GetDynamicMeshElements(const TArray<const FSceneView*>& Views, const FSceneViewFamily& ViewFamily, uint32 VisibilityMap, FMeshElementCollector& Collector) const
+{
+    LINE_RENDERER_SCOPE_CYCLE_COUNTER(STAT_LineRenderer_GetMeshElements);
+
+    const FEngineShowFlags& EngineShowFlags = ViewFamily.EngineShowFlags;
+
+    const bool bIsWireframeView = AllowDebugViewmodes() && EngineShowFlags.Wireframe;
+
+#if ENGINE_MAJOR_VERSION > 4 && ENGINE_MINOR_VERSION > 3
+    FRHICommandListBase& RHICmdList = Collector.GetRHICommandList();
+#else
+    FRHICommandListBase& RHICmdList = FRHICommandListExecutor::GetImmediateCommandList();
+#endif
+
+    // Sections shown when ready appear in the first frame after their build tasks finished
+    ResolvePendingSections_RenderThread(RHICmdList, false);
+
+    TArray<FLineExpansionView, TInlineAllocator<2>> ExpansionViews;
+    ExpansionViews.Reserve(Views.Num());
+
+    // View whose state keys the expansion of each view, the primary eye for both eyes of a stereo pair
+    TArray<int32, TInlineAllocator<2>> ExpansionKeyViews;
+    ExpansionKeyViews.Reserve(Views.Num());
+
+    int32 StereoPrimaryViewIndex = INDEX_NONE;
+
+    for (int32 ViewIndex = 0; ViewIndex < Views.Num(); ViewIndex++)
+    {
+        const FSceneView* View = Views[ViewIndex];
+
+        ExpansionViews.Emplace(View->ViewMatrices.GetViewProjectionMatrix(), View->ViewMatrices.GetInvViewProjectionMatrix(), View->ViewMatrices.GetProjectionMatrix(), View->UnscaledViewRect.Width());
+        ExpansionKeyViews.Add(ViewIndex);
+
+        if (!IStereoRendering::IsStereoEyeView(*View))
+        {
+            continue;
+        }
+
+        if (IStereoRendering::IsAPrimaryView(*View))
+        {
+            StereoPrimaryViewIndex = ViewIndex;
+        }
+        else if (StereoPrimaryViewIndex != INDEX_NONE && Views[StereoPrimaryViewIndex]->UnscaledViewRect.Size() == View->UnscaledViewRect.Size())
+        {
+            // Both eyes expand with the midpoint basis, the second eye then draws what the first one expanded
+            ExpansionViews[ViewIndex] = FLineExpansionView::GetStereoMidpoint(ExpansionViews[StereoPrimaryViewIndex], ExpansionViews[ViewIndex]);
+            ExpansionViews[StereoPrimaryViewIndex] = ExpansionViews[ViewIndex];
+            ExpansionKeyViews[ViewIndex] = StereoPrimaryViewIndex;
+        }
+    }
+
+    const bool bSectionCulling = CVarLineRendererSectionCulling.GetValueOnRenderThread() != 0;
+    const float MaxScreenError = CVarLineRendererLODScreenError.GetValueOnRenderThread();
+    const FMatrix& LocalToWorld = GetLocalToWorld();
+
+    // Group drawable sections by material, sections sharing one can be drawn together.
+    // The groups do not depend on the views, so every call of a frame packs the same batches.
+    // Sections outside of every view frustum of this call are not drawn, their batch is drawn when another of its sections is
+    TMap<const FMaterialRenderProxy*, TArray<FLineProxySection*, TInlineAllocator<4>>> SectionsByMaterial;
+    bool bAnySectionInView = false;
+
+    {
+        LINE_RENDERER_SCOPE_CYCLE_COUNTER(STAT_LineRenderer_CullSections);
+
+        for (const TSharedPtr<FLineProxySection>& SectionPtr : Sections_RenderThread)
+        {
+            FLineProxySection* Section = SectionPtr.Get();
+
+            if (Section == nullptr || !Section->bInitialized || !Section->bSectionVisible || Section->bStaticDraw)
+            {
+                continue;
+            }
+
+            Section->ViewVisibilityMap = VisibilityMap;
+
+            if (bSectionCulling)
+            {
+                for (int32 ViewIndex = 0; ViewIndex < Views.Num(); ViewIndex++)
+                {
+                    if (VisibilityMap & (1 << ViewIndex))
+                    {
+                        const FBox WorldBox = GetExpandedSectionBox(ExpansionViews[ViewIndex], *Section).TransformBy(LocalToWorld);
+
+                        if (!IsBoxInViewFrustum(*Views[ViewIndex], WorldBox))
+                        {
+                            Section->ViewVisibilityMap &= ~(1 << ViewIndex);
+                            INC_DWORD_STAT(STAT_LineRenderer_CulledSections);
+                        }
+                    }
+                }
+            }
+
+            // One level per frame, selected by the first call that sees the section from the views it is drawn in.
+            // Batches and the expansion cache stay valid for the views of later calls
+            if (Section->LODFrameNumber != ViewFamily.FrameNumber)
+            {
+                if (MaxScreenError > 0.0f)
+                {
+                    Section->RebuildStaleLODs();
+                }
+
+                if (Section->ResolveLODs(RHICmdList, GeometryMode))
+                {
+                    PublishSectionMemory_RenderThread(*Section);
+                }
+
+                if (Section->ViewVisibilityMap != 0)
+                {
+                    Section->LODIndex = SelectSectionLOD(*Section, Views, LocalToWorld, MaxScreenError);
+                    Section->LODFrameNumber = ViewFamily.FrameNumber;
+                }
+                else
+                {
+                    // Not seen by this call, full resolution until a call that sees it picks the level
+                    Section->LODIndex = 0;
+                }
+            }
+
+            SectionsByMaterial.FindOrAdd(Section->Material->GetRenderProxy()).Add(Section);
+
+            if (Section->ViewVisibilityMap != 0)
+            {
+                bAnySectionInView = true;
+                INC_DWORD_STAT(STAT_LineRenderer_SectionsDrawn);
+            }
+        }
+    }
+
+    // Batches of materials without drawable sections are left from an earlier state of the sections, not from what this call's views see
+    for (auto It = MergedBatches_RenderThread.CreateIterator(); It; ++It)
+    {
+        if (!SectionsByMaterial.Contains(It.Key()))
+        {
+            It.RemoveCurrent();
+        }
+    }
+
+    for (auto It = InstancedBatches_RenderThread.CreateIterator(); It; ++It)
+    {
+        if (!SectionsByMaterial.Contains(It.Key()))
+        {
+            It.RemoveCurrent();
+        }
+    }
+
+    if (!bAnySectionInView)
+    {
+        return;
+    }
+
+    // All batches of this proxy share its transform, the primitive uniform buffer is set up once
+    bool bHasPrecomputedVolumetricLightmap;
+    FMatrix PreviousLocalToWorld;
+    int32 SingleCaptureIndex;
+    bool bOutputVelocity;
+    GetScene().GetPrimitiveUniformShaderParameters_RenderThread(GetPrimitiveSceneInfo(), bHasPrecomputedVolumetricLightmap, PreviousLocalToWorld, SingleCaptureIndex, bOutputVelocity);
+
+    FDynamicPrimitiveUniformBuffer& DynamicPrimitiveUniformBuffer = Collector.AllocateOneFrameResource<FDynamicPrimitiveUniformBuffer>();
+
+#if ENGINE_MAJOR_VERSION > 4 && ENGINE_MINOR_VERSION > 3
+    DynamicPrimitiveUniformBuffer.Set(Collector.GetRHICommandList(), GetLocalToWorld(), PreviousLocalToWorld, GetBounds(), GetLocalBounds(), true, bHasPrecomputedVolumetricLightmap, bOutputVelocity);
+#else
+    DynamicPrimitiveUniformBuffer.Set(GetLocalToWorld(), PreviousLocalToWorld, GetBounds(), GetLocalBounds(), true, bHasPrecomputedVolumetricLightmap, bOutputVelocity);
+#endif
+
+    const bool bStrip = GeometryMode == ELineGeometryMode::Strip;
+
+    // Instanced draws repeat the vertices of NumLines lines NumInstances times
+    auto AddLineMesh = [&](int32 ViewIndex, const FVertexFactory* VertexFactory, const FMaterialRenderProxy* MaterialProxy, const FIndexBuffer* IndexBuffer, int32 NumLines, int32 NumIndices, int32 NumInstances, int32 ElementIndex)
+    {
+        // Draw the mesh.
+        FMeshBatch& Mesh = Collector.AllocateMesh();
+        Mesh.VertexFactory = VertexFactory;
+        Mesh.MaterialRenderProxy = MaterialProxy;
+        Mesh.ReverseCulling = !IsLocalToWorldDeterminantNegative();
+        Mesh.Type = PT_TriangleList;
+        Mesh.DepthPriorityGroup = SDPG_World;
+        Mesh.bCanApplyViewModeOverrides = false;
+
+        if (AllowDebugViewmodes() && bIsWireframeView)
+        {
+            Mesh.bWireframe = true;
+        }
+
+        FMeshBatchElement& BatchElement = Mesh.Elements[0];
+        BatchElement.IndexBuffer = IndexBuffer;
+        BatchElement.PrimitiveUniformBufferResource = &DynamicPrimitiveUniformBuffer.UniformBuffer;
+
+        BatchElement.FirstIndex = 0;
+        BatchElement.NumPrimitives = NumIndices / 3;
+        BatchElement.NumInstances = NumInstances;
+        BatchElement.MinVertexIndex = 0;
+        BatchElement.MaxVertexIndex = NumLines * (IndexBuffer != nullptr ? GetNumVerticesPerLine(GeometryMode) : GetNumIndicesPerLine(GeometryMode)) - 1;
+
+#if ENABLE_DRAW_DEBUG
+        BatchElement.VisualizeElementIndex = ElementIndex;
+#endif
+
+        INC_DWORD_STAT(STAT_LineRenderer_MeshBatches);
+
+        Collector.AddMesh(ViewIndex, Mesh);
+    };
+
+    const bool bMergeSections = CVarLineRendererMergeSections.GetValueOnRenderThread() != 0;
+    const bool bExpansionCacheEnabled = CVarLineRendererExpansionCache.GetValueOnRenderThread() != 0;
+
+    // Slot of the pool holding the lines expanded for a view, Expand fills it on a miss
+    auto GetExpandedViewSlot = [&](FLineViewSlotPool& ViewSlots, uint32 Revision, int32 LODIndex, int32 ViewIndex, TFunctionRef<void(const FLineExpansionView&, FVector3f*)> Expand) -> FLineViewSlot&
+    {
+        const FSceneView* KeyView = Views[ExpansionKeyViews[ViewIndex]];
+        const FMatrix& WorldToClip = KeyView->ViewMatrices.GetViewProjectionMatrix();
+        const FIntPoint ViewportSize(KeyView->UnscaledViewRect.Width(), KeyView->UnscaledViewRect.Height());
+
+        // The second eye of a stereo pair draws the slot the first eye filled this frame
+        if (FLineViewSlot* SharedSlot = ViewSlots.FindExpandedThisFrame(ViewFamily.FrameNumber, Revision, LODIndex, WorldToClip, ViewportSize))
+        {
+            INC_DWORD_STAT(STAT_LineRenderer_SharedExpansions);
+            return *SharedSlot;
+        }
+
+        // Every other view gets its own slot, earlier views of this frame keep drawing their expansion
+        FLineViewSlot& Slot = ViewSlots.Acquire(RHICmdList, ViewFamily.FrameNumber, Revision, LODIndex, WorldToClip, ViewportSize);
+
+        if (bExpansionCacheEnabled && Slot.IsExpandedFor(Revision, LODIndex, WorldToClip, ViewportSize))
+        {
+            INC_DWORD_STAT(STAT_LineRenderer_ExpansionCacheHits);
+        }
+        else
+        {
+            INC_DWORD_STAT(STAT_LineRenderer_ExpansionCacheMisses);
+
+            FVector3f* ThickVertices = LockLineVertices(RHICmdList, *Slot.PositionVB);
+
+            Expand(ExpansionViews[ViewIndex], ThickVertices);
+
+            UnlockLineVertices(RHICmdList, *Slot.PositionVB);
+
+            Slot.SetExpandedFor(Revision, LODIndex, WorldToClip, ViewportSize);
+        }
+
+        return Slot;
+    };
+
+    FLineBatchFrameReferences& BatchReferences = Collector.AllocateOneFrameResource<FLineBatchFrameReferences>();
+
+    for (const TTuple<const FMaterialRenderProxy*, TArray<FLineProxySection*, TInlineAllocator<4>>>& MaterialSections : SectionsByMaterial)
+    {
+        const FMaterialRenderProxy* MaterialProxy = MaterialSections.Key;
+
+        // Sections expanded on the GPU are merged into an instanced batch of their own.
+        // Strips are not, their joints would reach into the neighboring section
+        TArray<FLineProxySection*, TInlineAllocator<4>> MergeableSections;
+        TArray<FLineProxySection*, TInlineAllocator<4>> InstanceableSections;
+
+        for (FLineProxySection* Section : MaterialSections.Value)
+        {
+            if (bMergeSections && !Section->bGPUExpansion)
+            {
+                MergeableSections.Add(Section);
+            }
+            else if (bMergeSections && !bStrip)
+            {
+                InstanceableSections.Add(Section);
+            }
+        }
+
+        FLineMergedBatch* MergedBatch = nullptr;
+
+        if (MergeableSections.Num() > 1)
+        {
+            TSharedPtr<FLineMergedBatch>& MergedBatchRef = MergedBatches_RenderThread.FindOrAdd(MaterialProxy);
+
+            if (MergedBatchRef.IsValid() && MergedBatchRef->HasSections(MergeableSections))
+            {
+                MergedBatchRef->UpdateRevisions(MergeableSections);
+            }
+            else
+            {
+                // Sections changed since the batch was packed, meshes of earlier calls keep the old batch through their frame references
+                MergedBatchRef = MakeShareable(new FLineMergedBatch(GetScene().GetFeatureLevel()));
+                MergedBatchRef->SetSections(RHICmdList, MergeableSections, GeometryMode, bVertexColor);
+            }
+
+            MergedBatch = MergedBatchRef.Get();
+            BatchReferences.MergedBatches.Add(MergedBatchRef);
+        }
+        else
+        {
+            // Fewer than two sections of this material can be merged, which no view changes
+            MergedBatches_RenderThread.Remove(MaterialProxy);
+        }
+
+        FLineInstancedBatch* InstancedBatch = nullptr;
+
+        if (InstanceableSections.Num() > 1)
+        {
+            TSharedPtr<FLineInstancedBatch>& InstancedBatchRef = InstancedBatches_RenderThread.FindOrAdd(MaterialProxy);
+
+            if (InstancedBatchRef.IsValid() && InstancedBatchRef->HasSections(InstanceableSections))
+            {
+                InstancedBatchRef->UpdateLines(RHICmdList, InstanceableSections);
+            }
+            else
+            {
+                // Same as merged batches, the replaced batch lives on in the frame references of earlier calls
+                InstancedBatchRef = MakeShareable(new FLineInstancedBatch(GetScene().GetFeatureLevel()));
+                InstancedBatchRef->SetSections(RHICmdList, InstanceableSections, GeometryMode);
+            }
+
+            InstancedBatch = InstancedBatchRef.Get();
+            BatchReferences.InstancedBatches.Add(InstancedBatchRef);
+        }
+        else
+        {
+            InstancedBatches_RenderThread.Remove(MaterialProxy);
+        }
+
+        // For each view..
+        for (int32 ViewIndex = 0; ViewIndex < Views.Num(); ViewIndex++)
+        {
+            if (VisibilityMap & (1 << ViewIndex))
+            {
+                // Merged batches are drawn as a whole as long as one of their sections is in this view.
+                // Only sections in this view count as saved draws, the culled ones would not have been drawn anyway
+                int32 NumMergedSectionsInView = 0;
+                int32 NumInstancedSectionsInView = 0;
+
+                if (MergedBatch != nullptr)
+                {
+                    for (const FLineProxySection* Section : MergeableSections)
+                    {
+                        NumMergedSectionsInView += (Section->ViewVisibilityMap >> ViewIndex) & 1;
+                    }
+                }
+
+                if (InstancedBatch != nullptr)
+                {
+                    for (const FLineProxySection* Section : InstanceableSections)
+                    {
+                        NumInstancedSectionsInView += (Section->ViewVisibilityMap >> ViewIndex) & 1;
+                    }
+                }
+
+                if (NumInstancedSectionsInView > 0)
+                {
+                    const int32 NumLines = InstancedBatch->Lines.Num();
+                    AddLineMesh(ViewIndex, &InstancedBatch->LineVertexFactory, MaterialProxy, nullptr, 1, GetNumIndicesPerLine(GeometryMode), NumLines, InstanceableSections[0]->SectionIndex);
+
+                    INC_DWORD_STAT_BY(STAT_LineRenderer_SegmentsExpanded, NumLines);
+                    INC_DWORD_STAT_BY(STAT_LineRenderer_MergedDrawsSaved, NumInstancedSectionsInView - 1);
+                }
+
+                if (NumMergedSectionsInView > 0)
+                {
+                    // Sections culled for this view are not expanded, the cached expansion is keyed on which sections were
+                    uint32 ExpansionRevision = MergedBatch->Revision;
+
+                    for (const FLineProxySection* Section : MergeableSections)
+                    {
+                        ExpansionRevision = HashCombine(ExpansionRevision, (Section->ViewVisibilityMap >> ViewIndex) & 1);
+                    }
+
+                    FLineViewSlot& Slot = GetExpandedViewSlot(MergedBatch->ViewSlots, ExpansionRevision, 0, ViewIndex, [&](const FLineExpansionView& ExpansionView, FVector3f* ThickVertices)
+                    {
+                        // Sections are packed back to back, each one may use its own screen space mode
+                        for (const FLineProxySection* Section : MergeableSections)
+                        {
+                            const int32 NumSectionVertices = Section->GetDrawnLines().Num() * GetNumVerticesPerLine(GeometryMode);
+
+                            if (Section->ViewVisibilityMap & (1 << ViewIndex))
+                            {
+                                ExpandLinesToBuffer(ExpansionView, Section->bScreenSpace, GeometryMode, Section->GetDrawnLines(), ThickVertices);
+                            }
+                            else
+                            {
+                                // All vertices on one point, the triangles of the section are degenerate and draw nothing
+                                FMemory::Memzero(ThickVertices, NumSectionVertices * sizeof(FVector3f));
+                            }
+
+                            ThickVertices += NumSectionVertices;
+                        }
+                    });
+
+                    if (bStrip)
+                    {
+                        AddLineMesh(ViewIndex, &Slot.VertexFactory, MaterialProxy, &MergedBatch->StripIndexBuffer, MergedBatch->NumLines, MergedBatch->StripIndexBuffer.GetNumIndices(), 1, MergeableSections[0]->SectionIndex);
+                    }
+                    else
+                    {
+                        AddLineMesh(ViewIndex, &Slot.VertexFactory, MaterialProxy, &MergedBatch->Topology->IndexBuffer, MergedBatch->NumLines, MergedBatch->NumLines * GetNumIndicesPerLine(GeometryMode), 1, MergeableSections[0]->SectionIndex);
+                    }
+
+                    INC_DWORD_STAT_BY(STAT_LineRenderer_MergedDrawsSaved, NumMergedSectionsInView - 1);
+                }
+
+                for (FLineProxySection* Section : MaterialSections.Value)
+                {
+                    if (Section->bGPUExpansion ? InstancedBatch != nullptr : MergedBatch != nullptr)
+                    {
+                        continue;
+                    }
+
+                    if (!(Section->ViewVisibilityMap & (1 << ViewIndex)))
+                    {
+                        continue;
+                    }
+
+                    // Lines expanded on the GPU have nothing to upload
+                    FLineViewSlot* Slot = nullptr;
+
+                    if (!Section->bGPUExpansion)
+                    {
+                        Slot = &GetExpandedViewSlot(Section->ViewSlots, Section->Revision, Section->LODIndex, ViewIndex, [&](const FLineExpansionView& ExpansionView, FVector3f* ThickVertices)
+                        {
+                            ExpandLinesToBuffer(ExpansionView, Section->bScreenSpace, GeometryMode, Section->GetDrawnLines(), ThickVertices);
+                        });
+                    }
+
+                    const int32 NumDrawnLines = Section->GetDrawnLines().Num();
+                    FLineSectionLOD* SectionLOD = Section->LODIndex > 0 ? Section->LODs[Section->LODIndex - 1].Get() : nullptr;
+
+                    if (Section->bGPUExpansion)
+                    {
+                        const FLineVertexFactory* LineVertexFactory = SectionLOD != nullptr ? &SectionLOD->LineVertexFactory : &Section->LineVertexFactory;
+                        AddLineMesh(ViewIndex, LineVertexFactory, MaterialProxy, nullptr, 1, GetNumIndicesPerLine(GeometryMode), NumDrawnLines, Section->SectionIndex);
+
+                        INC_DWORD_STAT_BY(STAT_LineRenderer_SegmentsExpanded, NumDrawnLines);
+                    }
+                    else if (bStrip)
+                    {
+                        const FRawStaticIndexBuffer& StripIndexBuffer = SectionLOD != nullptr ? SectionLOD->StripIndexBuffer : Section->StripIndexBuffer;
+                        const int32 NumStripIndices = SectionLOD != nullptr ? SectionLOD->StripIndexBuffer.GetNumIndices() : Section->NumStripIndices;
+                        AddLineMesh(ViewIndex, &Slot->VertexFactory, MaterialProxy, &StripIndexBuffer, NumDrawnLines, NumStripIndices, 1, Section->SectionIndex);
+                    }
+                    else
+                    {
+                        AddLineMesh(ViewIndex, &Slot->VertexFactory, MaterialProxy, &Section->Topology->IndexBuffer, NumDrawnLines, NumDrawnLines * GetNumIndicesPerLine(GeometryMode), 1, Section->SectionIndex);
+                    }
+                }
+            }
+        }
+    }
+
+    // Draw bounds
+#if !(UE_BUILD_SHIPPING || UE_BUILD_TEST)
+    if (bIsWireframeView)
+    {
+        for (int32 ViewIndex = 0; ViewIndex < Views.Num(); ViewIndex++)
+        {
+            if (VisibilityMap & (1 << ViewIndex))
+            {
+                RenderBounds(Collector.GetPDI(ViewIndex), EngineShowFlags, GetBounds(), IsSelected());
+            }
+        }
+    }
+#endif
+}
+
+void FLineRendererComponentSceneProxy::DrawStaticElements(FStaticPrimitiveDrawInterface* PDI)
+{
+    // Static sections do not change for the lifetime of the proxy, the engine caches their mesh draw commands
+    for (const TSharedPtr<FLineProxySection>& SectionPtr : Sections_RenderThread)
+    {
+        const FLineProxySection* Section = SectionPtr.Get();
+
+        if (Section == nullptr || !Section->bStaticDraw || !Section->bInitialized || !Section->bSectionVisible || Section->Lines.Num() == 0)
+        {
+            continue;
+        }
+
+        // Every face of a tube is drawn as one ribbon
+        const int32 NumFaces = Section->Lines.Num() * NumFacesPerStaticLine;
+
+        FMeshBatch Mesh;
+        Mesh.VertexFactory = &Section->StaticVertexFactory;
+        Mesh.MaterialRenderProxy = Section->Material->GetRenderProxy();
+        Mesh.ReverseCulling = !IsLocalToWorldDeterminantNegative();
+        Mesh.Type = PT_TriangleList;
+        Mesh.DepthPriorityGroup = SDPG_World;
+        Mesh.LODIndex = 0;
+        Mesh.CastShadow = true;
+
+        FMeshBatchElement& BatchElement = Mesh.Elements[0];
+        BatchElement.IndexBuffer = &Section->Topology->IndexBuffer;
+        BatchElement.FirstIndex = 0;
+        BatchElement.NumPrimitives = NumFaces * NumIndicesPerRibbonLine / 3;
+        BatchElement.MinVertexIndex = 0;
+        BatchElement.MaxVertexIndex = NumFaces * NumVerticesPerRibbonLine - 1;
+
+#if ENABLE_DRAW_DEBUG
+        BatchElement.VisualizeElementIndex = Section->SectionIndex;
+#endif
+
+        PDI->DrawMesh(Mesh, FLT_MAX);
+    }
+}
+
+FPrimitiveViewRelevance FLineRendererComponentSceneProxy::GetViewRelevance(const FSceneView* View) const
+{
+    FPrimitiveViewRelevance Result;
+    Result.bDrawRelevance = IsShown(View);
+    Result.bShadowRelevance = IsShadowCast(View);
+    // Proxies with static sections only skip GetDynamicMeshElements until a dynamic section is added
+    Result.bStaticRelevance = bHasStaticSections;
+    Result.bDynamicRelevance = bHasDynamicSections_RenderThread || !bHasStaticSections;
+    Result.bRenderInMainPass = ShouldRenderInMainPass();
+    Result.bUsesLightingChannels = GetLightingChannelMask() != GetDefaultLightingChannelMask();
+    Result.bRenderCustomDepth = ShouldRenderCustomDepth();
+    Result.bTranslucentSelfShadow = bCastVolumetricTranslucentShadow;
+    
+    Result.bVelocityRelevance = IsMovable() && Result.bOpaque && Result.bRenderInMainPass;
+
+    MaterialRelevance.SetPrimitiveViewRelevance(Result);
+
+    return Result;
+}
+
+TSharedRef<FLineProxySection> FLineRendererComponentSceneProxy::CreateSection_GameThread(const FLineSectionInfo* SrcSection)
+{
+    check(IsInGameThread());
+
+    const int32 NumVerts = SrcSection->GetNumLines() * GetNumVerticesPerLine(GeometryMode);
+
+    const int32 SrcSectionIndex = SrcSection->SectionIndex;
+
+    TSharedRef<FLineProxySection> NewSection(MakeShareable(new FLineProxySection(GetScene().GetFeatureLevel())));
+    {
+        NewSection->MaxVertexIndex = NumVerts - 1;
+        NewSection->SectionIndex = SrcSectionIndex;
+        NewSection->bScreenSpace = SrcSection->bScreenSpace;
+        NewSection->bSectionVisible = SrcSection->bVisible;
+        NewSection->Material = SrcSection->Material;
+        NewSection->Color = SrcSection->Color;
+
+        // The component may change its points as soon as this returns, lines are copied here and everything else is built from them
+        PackSectionLines(*SrcSection, 0, bVertexColor, NewSection->Lines);
+
+        NewSection->LineCapacity = NewSection->Lines.Num();
+
+        NewSection->bStaticDraw = bStaticLines && !SrcSection->bScreenSpace;
+        NewSection->bGPUExpansion = bGPUExpansion && !NewSection->bStaticDraw;
+        NewSection->bVertexColor = bVertexColor;
+
+        // Sizes only depend on the number of lines, they are known before the section is built
+        if (NewSection->bStaticDraw)
+        {
+            NewSection->Memory.VertexBytes = NewSection->Lines.Num() * NumVerticesPerStaticLine * sizeof(FVector3f);
+            NewSection->Memory.ColorBytes = bVertexColor ? NewSection->Lines.Num() * NumVerticesPerStaticLine * sizeof(FColor) : 0;
+
+            StaticSections_GameThread.Add(SrcSectionIndex);
+        }
+        else if (NewSection->bGPUExpansion)
+        {
+            // Endpoints are uploaded once, the vertex shader expands them every frame
+            NewSection->SegmentBuffer.Lines = NewSection->Lines;
+
+            NewSection->Memory.VertexBytes = NewSection->SegmentBuffer.GetSizeInBytes();
+        }
+        else
+        {
+            // Positions are allocated per view on first draw, this is the size of one view slot.
+            // Indices, UVs and tangents come from the shared topology buffers
+            NewSection->Memory.VertexBytes = FDynamicPositionVertexBuffer(NumVerts).GetSizeInBytes();
+            NewSection->Memory.IndexBytes = GeometryMode == ELineGeometryMode::Strip ? GetStripIndexDataSize(NewSection->Lines) : 0;
+            NewSection->Memory.ColorBytes = bVertexColor ? NumVerts * sizeof(FColor) : 0;
+        }
+    }
+
+    // Simplified levels are built off the game thread and picked up by the render thread when ready
+    if (!NewSection->bStaticDraw && NewSection->Lines.Num() >= LineLODMinLines && CVarLineRendererLODScreenError.GetValueOnGameThread() > 0.0f)
+    {
+        NewSection->LODTask = UE::Tasks::Launch(UE_SOURCE_LOCATION, [Lines = NewSection->Lines]()
+        {
+            LINE_RENDERER_SCOPE_CYCLE_COUNTER(STAT_LineRenderer_BuildLODs);
+
+            TArray<FLineLOD> LODs;
+            BuildLineLODs(Lines, LODs);
+            return LODs;
+        });
+    }
+
+    NewSection->Memory.LineBytes = NewSection->Lines.GetAllocatedSize();
+    {
+        FScopeLock Lock(&SectionMemoryLock);
+        SectionMemory.Add(SrcSectionIndex, NewSection->Memory);
+    }
+
+    return NewSection;
+}
+
+/** Fills the CPU side of the render resources of a section from its packed lines. Touches nothing but the section, runs on any thread */
+static void BuildSection_AnyThread(FLineProxySection& Section, ELineGeometryMode Mode)
+{
+    Section.SectionLocalBox = FBox3f(EForceInit::ForceInitToZero);
+
+    for (const FPackedLine& Line : Section.Lines)
+    {
+        Section.SectionLocalBox += FVector3f(Line.StartAndThickness);
+        Section.SectionLocalBox += FVector3f(Line.End);
+        Section.SectionThickness = FMath::Max(Section.SectionThickness, Line.StartAndThickness.W);
+    }
+
+    // Render resources are only filled here, they are initialized by the render command of the whole batch
+    if (Section.bStaticDraw)
+    {
+        // World thickness tubes do not depend on the view, they are built once instead of expanded every frame
+        TArray<FVector3f> Positions;
+        Positions.SetNumUninitialized(Section.Lines.Num() * NumVerticesPerStaticLine);
+        BuildStaticLineVertices(Section.Lines, Positions.GetData());
+
+        Section.StaticPositionBuffer.Init(Positions, false);
+
+        if (Section.bVertexColor)
+        {
+            TArray<FColor> Colors;
+            BuildLineVertexColors(Section.Lines, NumVerticesPerStaticLine, Colors);
+
+            Section.ColorVertexBuffer.InitFromColorArray(Colors.GetData(), Colors.Num(), sizeof(FColor), false);
+        }
+    }
+    else if (!Section.bGPUExpansion)
+    {
+        if (Mode == ELineGeometryMode::Strip)
+        {
+            TArray<uint32> Indices;
+            BuildStripIndices(Section.Lines, 0, Indices);
+
+            Section.StripIndexBuffer.SetIndices(Indices, EIndexBufferStride::AutoDetect);
+            Section.NumStripIndices = Indices.Num();
+        }
+
+        if (Section.bVertexColor)
+        {
+            TArray<FColor> Colors;
+            BuildLineVertexColors(Section.Lines, GetNumVerticesPerLine(Mode), Colors);
+
+            Section.ColorVertexBuffer.InitFromColorArray(Colors.GetData(), Colors.Num(), sizeof(FColor), false);
+        }
+    }
+}
+
+void FLineRendererComponentSceneProxy::InitSection_RenderThread(FRHICommandListBase& RHICmdList, FLineProxySection& Section) const
+{
+    check(IsInRenderingThread());
+
+    if (Section.bStaticDraw)
+    {
+        InitStaticSection_RenderThread(RHICmdList, Section);
+        return;
+    }
+
+    if (Section.bGPUExpansion)
+    {
+        Section.LineVertexFactory.SetSegmentBuffer(&Section.SegmentBuffer, Section.bScreenSpace, GeometryMode);
+
+#if ENGINE_MAJOR_VERSION > 4 && ENGINE_MINOR_VERSION > 3
+        Section.SegmentBuffer.InitResource(RHICmdList);
+        Section.LineVertexFactory.InitResource(RHICmdList);
+#else
+        Section.SegmentBuffer.InitResource();
+        Section.LineVertexFactory.InitResource();
+#endif
+        return;
+    }
+
+    if (GeometryMode == ELineGeometryMode::Strip)
+    {
+#if ENGINE_MAJOR_VERSION > 4 && ENGINE_MINOR_VERSION > 3
+        Section.StripIndexBuffer.InitResource(RHICmdList);
+#else
+        Section.StripIndexBuffer.InitResource();
+#endif
+        INC_DWORD_STAT_BY(STAT_LineRenderer_BytesUploaded, Section.StripIndexBuffer.GetIndexDataSize());
+    }
+
+    Section.Topology = FLineTopologyBuffers::Get(RHICmdList, GeometryMode, Section.LineCapacity);
+
+    // Positions are bound per view slot
+    FLocalVertexFactory::FDataType Data;
+
+    // Using LocalVertexFactory requires to init all buffers
+    FStaticMeshVertexBuffer& StaticMeshVB = Section.Topology->StaticMeshVertexBuffer;
+    StaticMeshVB.BindTangentVertexBuffer(nullptr, Data);
+    StaticMeshVB.BindPackedTexCoordVertexBuffer(nullptr, Data);
+    StaticMeshVB.BindLightMapVertexBuffer(nullptr, Data, 1);
+
+    if (Section.bVertexColor)
+    {
+#if ENGINE_MAJOR_VERSION > 4 && ENGINE_MINOR_VERSION > 3
+        Section.ColorVertexBuffer.InitResource(RHICmdList);
+#else
+        Section.ColorVertexBuffer.InitResource();
+#endif
+        INC_DWORD_STAT_BY(STAT_LineRenderer_BytesUploaded, Section.ColorVertexBuffer.GetNumVertices() * sizeof(FColor));
+
+        Section.ColorVertexBuffer.BindColorVertexBuffer(nullptr, Data);
+    }
+
+    Data.LODLightmapDataIndex = 0;
+
+    Section.ViewSlots.Reset(RHICmdList, Data, Section.LineCapacity * GetNumVerticesPerLine(GeometryMode));
+}
+
+void FLineRendererComponentSceneProxy::InitStaticSection_RenderThread(FRHICommandListBase& RHICmdList, FLineProxySection& Section) const
+{
+    // Tube faces are laid out as ribbons, the ribbon topology of four times the lines covers the section
+    Section.Topology = FLineTopologyBuffers::Get(RHICmdList, ELineGeometryMode::Ribbon, Section.Lines.Num() * NumFacesPerStaticLine);
+
+#if ENGINE_MAJOR_VERSION > 4 && ENGINE_MINOR_VERSION > 3
+    Section.StaticPositionBuffer.InitResource(RHICmdList);
+#else
+    Section.StaticPositionBuffer.InitResource();
+#endif
+    INC_DWORD_STAT_BY(STAT_LineRenderer_BytesUploaded, Section.Memory.VertexBytes);
+
+    FLocalVertexFactory::FDataType Data;
+    Section.StaticPositionBuffer.BindPositionVertexBuffer(&Section.StaticVertexFactory, Data);
+
+    FStaticMeshVertexBuffer& StaticMeshVB = Section.Topology->StaticMeshVertexBuffer;
+    StaticMeshVB.BindTangentVertexBuffer(&Section.StaticVertexFactory, Data);
+    StaticMeshVB.BindPackedTexCoordVertexBuffer(&Section.StaticVertexFactory, Data);
+    StaticMeshVB.BindLightMapVertexBuffer(&Section.StaticVertexFactory, Data, 1);
+
+    if (Section.bVertexColor)
+    {
+#if ENGINE_MAJOR_VERSION > 4 && ENGINE_MINOR_VERSION > 3
+        Section.ColorVertexBuffer.InitResource(RHICmdList);
+#else
+        Section.ColorVertexBuffer.InitResource();
+#endif
+        INC_DWORD_STAT_BY(STAT_LineRenderer_BytesUploaded, Section.Memory.ColorBytes);
+
+        Section.ColorVertexBuffer.BindColorVertexBuffer(&Section.StaticVertexFactory, Data);
+    }
+
+    Data.LODLightmapDataIndex = 0;
+
+#if ENGINE_MAJOR_VERSION > 4 && ENGINE_MINOR_VERSION > 3
+    Section.StaticVertexFactory.SetData(RHICmdList, Data);
+    Section.StaticVertexFactory.InitResource(RHICmdList);
+#else
+    Section.StaticVertexFactory.SetData(Data);
+    Section.StaticVertexFactory.InitResource();
+#endif
+}
+
+void FLineRendererComponentSceneProxy::ResizeSection_RenderThread(FRHICommandListBase& RHICmdList, FLineProxySection& Section, int32 NewCapacity) const
+{
+    check(IsInRenderingThread());
+
+    const int32 VerticesPerLine = GetNumVerticesPerLine(GeometryMode);
+
+    Section.LineCapacity = NewCapacity;
+    Section.bStreaming = true;
+
+    if (Section.bGPUExpansion)
+    {
+        Section.LineVertexFactory.ReleaseResource();
+        Section.SegmentBuffer.ReleaseResource();
+
+        // Lines are uploaded from the first slot again
+        Section.SegmentBuffer.Lines = Section.GetLines();
+        Section.SegmentBuffer.Capacity = NewCapacity;
+        Section.SegmentBuffer.FirstLine = 0;
+
+        Section.Memory.VertexBytes = Section.SegmentBuffer.GetSizeInBytes();
+    }
+    else
+    {
+        // View slots are reallocated by InitSection_RenderThread
+        Section.Memory.VertexBytes = FDynamicPositionVertexBuffer(NewCapacity * VerticesPerLine).GetSizeInBytes();
+
+        // Appended lines always continue the previous one, indices of the whole capacity are known ahead
+        if (GeometryMode == ELineGeometryMode::Strip)
+        {
+            TArray<uint32> Indices;
+            BuildJoinedStripIndices(NewCapacity, 0, Indices);
+
+            Section.StripIndexBuffer.ReleaseResource();
+            Section.StripIndexBuffer.SetIndices(Indices, EIndexBufferStride::AutoDetect);
+            Section.NumStripIndices = GetNumJoinedStripIndices(Section.GetLines().Num());
+
+            Section.Memory.IndexBytes = Section.StripIndexBuffer.GetIndexDataSize();
+        }
+
+        // All lines of a section share its color
+        if (Section.bVertexColor && Section.Lines.Num() > 0)
+        {
+            TArray<FColor> Colors;
+            Colors.Init(GetPackedLineColor(Section.Lines.Last()), NewCapacity * VerticesPerLine);
+
+            Section.ColorVertexBuffer.ReleaseResource();
+            Section.ColorVertexBuffer.InitFromColorArray(Colors.GetData(), Colors.Num(), sizeof(FColor), false);
+
+            Section.Memory.ColorBytes = Colors.Num() * sizeof(FColor);
+        }
+    }
+
+    InitSection_RenderThread(RHICmdList, Section);
+}
+
+void FLineRendererComponentSceneProxy::AppendSectionLines_RenderThread(FRHICommandListBase& RHICmdList, FLineProxySection& Section, TConstArrayView<FPackedLine> NewLines, int32 MaxLines) const
+{
+    check(IsInRenderingThread());
+
+    LINE_RENDERER_SCOPE_CYCLE_COUNTER(STAT_LineRenderer_UpdateSections);
+
+    if (NewLines.Num() == 0)
+    {
+        return;
+    }
+
+    Section.Lines.Append(NewLines.GetData(), NewLines.Num());
+
+    // The box only grows, dropped lines keep it conservative until they are compacted away
+    for (const FPackedLine& Line : NewLines)
+    {
+        Section.SectionLocalBox += FVector3f(Line.StartAndThickness);
+        Section.SectionLocalBox += FVector3f(Line.End);
+        Section.SectionThickness = FMath::Max(Section.SectionThickness, Line.StartAndThickness.W);
+    }
+
+    // Ring buffer mode drops the oldest lines by moving the first line
+    const int32 NumDropped = MaxLines > 0 ? FMath::Max(Section.GetLines().Num() - MaxLines, 0) : 0;
+    Section.FirstLine += NumDropped;
+
+    // Dropped lines are removed once they outnumber the others, which keeps appends amortized O(1)
+    if (Section.FirstLine > Section.GetLines().Num())
+    {
+        Section.Lines.RemoveAt(0, Section.FirstLine, false);
+        Section.FirstLine = 0;
+
+        // The removal visits every line anyway, the box shrinks back to the lines left
+        Section.SectionLocalBox = FBox3f(ForceInit);
+        for (const FPackedLine& Line : Section.Lines)
+        {
+            Section.SectionLocalBox += FVector3f(Line.StartAndThickness);
+            Section.SectionLocalBox += FVector3f(Line.End);
+        }
+    }
+
+    const int32 NumLines = Section.GetLines().Num();
+    const int32 NumNewLines = FMath::Min(NewLines.Num(), NumLines);
+
+    Section.MaxVertexIndex = NumLines * GetNumVerticesPerLine(GeometryMode) - 1;
+    Section.Memory.LineBytes = Section.Lines.GetAllocatedSize();
+    ++Section.TopologyRevision;
+    ++Section.Revision;
+
+    // Simplified levels no longer match, they are built again once the section stops streaming
+    Section.InvalidateLODs();
+
+    if (!Section.bStreaming || NumLines > Section.LineCapacity)
+    {
+        // Geometric growth keeps appending amortized O(1), ring buffers never grow past their size
+        int32 NewCapacity = FMath::Max(NumLines, Section.LineCapacity * 2);
+        if (MaxLines > 0)
+        {
+            NewCapacity = FMath::Min(NewCapacity, MaxLines);
+        }
+
+        ResizeSection_RenderThread(RHICmdList, Section, NewCapacity);
+        return;
+    }
+
+    if (Section.bGPUExpansion)
+    {
+        // Only the new lines are uploaded, the first slot moves past the dropped ones
+        FLineSegmentBuffer& SegmentBuffer = Section.SegmentBuffer;
+
+        SegmentBuffer.FirstLine = (SegmentBuffer.FirstLine + NumDropped) % SegmentBuffer.GetNumSlots();
+        SegmentBuffer.Lines = Section.GetLines();
+        SegmentBuffer.WriteLines(RHICmdList, SegmentBuffer.FirstLine + NumLines - NumNewLines, Section.GetLines().Right(NumNewLines));
+
+        Section.LineVertexFactory.UpdateLineRange();
+    }
+    else if (GeometryMode == ELineGeometryMode::Strip)
+    {
+        Section.NumStripIndices = GetNumJoinedStripIndices(NumLines);
+    }
+
+    // CPU positions are written by the next expansion, the other buffers already cover the capacity
+}
+
+void FLineRendererComponentSceneProxy::AddNewSections_GameThread(TConstArrayView<const FLineSectionInfo*> SrcSections)
+{
+    check(IsInGameThread());
+
+    if (SrcSections.Num() == 0)
+    {
+        return;
+    }
+
+    LINE_RENDERER_SCOPE_CYCLE_COUNTER(STAT_LineRenderer_CreateSections);
+
+    TArray<TSharedRef<FLineProxySection>> NewSections;
+    NewSections.Reserve(SrcSections.Num());
+
+    bool bHasStaticNewSections = false;
+
+    for (const FLineSectionInfo* SrcSection : SrcSections)
+    {
+        NewSections.Add(CreateSection_GameThread(SrcSection));
+        bHasStaticNewSections |= NewSections.Last()->bStaticDraw;
+    }
+
+    // Consecutive sections are built together until a task has enough lines to be worth launching.
+    // A batch too small for a single task is built right here
+    TArray<UE::Tasks::FTask> BuildTasks;
+    const ELineSectionBuildMode BatchBuildMode = bHasStaticNewSections ? ELineSectionBuildMode::BlockUntilReady : SectionBuildMode;
+    const ELineGeometryMode Mode = GeometryMode;
+
+    for (int32 FirstSection = 0; FirstSection < NewSections.Num();)
+    {
+        int32 NumTaskLines = 0;
+        int32 NumTaskSections = 0;
+
+        while (FirstSection + NumTaskSections < NewSections.Num() && NumTaskLines < LineSectionBuildTaskLines)
+        {
+            NumTaskLines += NewSections[FirstSection + NumTaskSections]->Lines.Num();
+            ++NumTaskSections;
+        }
+
+        TArray<TSharedRef<FLineProxySection>> TaskSections(NewSections.GetData() + FirstSection, NumTaskSections);
+        FirstSection += NumTaskSections;
+
+        auto BuildSections = [TaskSections = MoveTemp(TaskSections), Mode]()
+        {
+            LINE_RENDERER_SCOPE_CYCLE_COUNTER(STAT_LineRenderer_BuildSections);
+
+            for (const TSharedRef<FLineProxySection>& Section : TaskSections)
+            {
+                BuildSection_AnyThread(*Section, Mode);
+            }
+        };
+
+        if (NumTaskLines < LineSectionBuildTaskLines && BuildTasks.Num() == 0)
+        {
+            BuildSections();
+        }
+        else
+        {
+            // Sections shown when ready do not hold up tasks of the frame
+            const UE::Tasks::ETaskPriority Priority = BatchBuildMode == ELineSectionBuildMode::ShowWhenReady ? UE::Tasks::ETaskPriority::BackgroundNormal : UE::Tasks::ETaskPriority::Normal;
+            BuildTasks.Add(UE::Tasks::Launch(UE_SOURCE_LOCATION, MoveTemp(BuildSections), Priority));
+        }
+    }
+
+    if (BatchBuildMode == ELineSectionBuildMode::BlockUntilReady)
+    {
+        UE::Tasks::Wait(BuildTasks);
+        BuildTasks.Reset();
+    }
+
+#if WITH_EDITOR
+    TArray<UMaterialInterface*> UsedMaterials;
+    Component->GetUsedMaterials(UsedMaterials);
+#endif
+
+    // One command for the whole batch, each section replaces the previous one with the same index.
+    // Sections still being built are queued and initialized once their tasks are done
+    ENQUEUE_RENDER_COMMAND(LineVertexBuffersInit)(
+        [this, NewSections = MoveTemp(NewSections), BuildTasks = MoveTemp(BuildTasks)
+#if WITH_EDITOR
+        , UsedMaterials = MoveTemp(UsedMaterials)
+#endif
+        ](FRHICommandListImmediate& RHICmdList) mutable
+        {
+            for (const TSharedRef<FLineProxySection>& SectionRef : NewSections)
+            {
+                bHasDynamicSections_RenderThread |= !SectionRef->bStaticDraw;
+            }
+
+            // Sections built before this command are shown right away, along with every batch queued before them
+            const bool bBuilt = BuildTasks.Num() == 0;
+
+            if (!bBuilt)
+            {
+                // Resolved as soon as the tasks are done, not on the next frame this proxy happens to be drawn
+                UE::Tasks::Launch(UE_SOURCE_LOCATION, [this, WeakLifetimeToken = TWeakPtr<bool, ESPMode::ThreadSafe>(LifetimeToken)]()
+                {
+                    ENQUEUE_RENDER_COMMAND(LineResolvePendingSections)(
+                        [this, WeakLifetimeToken](FRHICommandListImmediate& InRHICmdList)
+                        {
+                            // The proxy is deleted on the render thread, a valid token means it outlives this command
+                            if (WeakLifetimeToken.Pin().IsValid())
+                            {
+                                ResolvePendingSections_RenderThread(InRHICmdList, false);
+                            }
+                        }
+                    );
+                }, UE::Tasks::Prerequisites(BuildTasks), UE::Tasks::ETaskPriority::BackgroundNormal);
+            }
+
+            FLinePendingSections& Pending = PendingSections_RenderThread.AddDefaulted_GetRef();
+            Pending.Sections = MoveTemp(NewSections);
+            Pending.BuildTasks = MoveTemp(BuildTasks);
+
+            ResolvePendingSections_RenderThread(RHICmdList, bBuilt);
+
+#if WITH_EDITOR
+            SetUsedMaterialForVerification(UsedMaterials);
+#endif
+        }
+    );
+}
+
+void FLineRendererComponentSceneProxy::ResolvePendingSections_RenderThread(FRHICommandListBase& RHICmdList, bool bWait) const
+{
+    check(IsInRenderingThread());
+
+    // In order, a later batch may replace a section of an earlier one
+    int32 NumResolved = 0;
+
+    for (; NumResolved < PendingSections_RenderThread.Num(); ++NumResolved)
+    {
+        FLinePendingSections& Pending = PendingSections_RenderThread[NumResolved];
+
+        if (bWait)
+        {
+            UE::Tasks::Wait(Pending.BuildTasks);
+        }
+        else if (Pending.BuildTasks.ContainsByPredicate([](const UE::Tasks::FTask& Task) { return !Task.IsCompleted(); }))
+        {
+            break;
+        }
+
+        LINE_RENDERER_SCOPE_CYCLE_COUNTER(STAT_LineRenderer_InitSections);
+
+        for (const TSharedRef<FLineProxySection>& SectionRef : Pending.Sections)
+        {
+            InitSection_RenderThread(RHICmdList, *SectionRef);
+
+            SectionRef->Handle = Sections_RenderThread.Add(SectionRef->SectionIndex, TSharedPtr<FLineProxySection>(SectionRef));
+
+            SectionRef->bInitialized = true;
+
+            PublishSectionMemory_RenderThread(*SectionRef);
+        }
+
+        for (TUniqueFunction<void(FRHICommandListBase&)>& Command : Pending.Commands)
+        {
+            Command(RHICmdList);
+        }
+    }
+
+    PendingSections_RenderThread.RemoveAt(0, NumResolved);
+}
+
+void FLineRendererComponentSceneProxy::RunAfterPendingSections_RenderThread(FRHICommandListBase& RHICmdList, TUniqueFunction<void(FRHICommandListBase&)>&& Command) const
+{
+    check(IsInRenderingThread());
+
+    ResolvePendingSections_RenderThread(RHICmdList, false);
+
+    // Sections still being built must see the commands enqueued after them, the render thread does not wait for the tasks
+    if (PendingSections_RenderThread.Num() > 0)
+    {
+        PendingSections_RenderThread.Last().Commands.Add(MoveTemp(Command));
+    }
+    else
+    {
+        Command(RHICmdList);
+    }
+}
+
+void FLineRendererComponentSceneProxy::PublishSectionMemory_RenderThread(const FLineProxySection& Section) const
+{
+    check(IsInRenderingThread());
+
+    const FLineSectionMemoryStats Stats = Section.GetMemoryWithLODs();
+
+    FScopeLock Lock(&SectionMemoryLock);
+    SectionMemory.Add(Section.SectionIndex, Stats);
+}
+
+bool FLineRendererComponentSceneProxy::CanBeOccluded() const
+{
+    return !MaterialRelevance.bDisableDepthTest;
+}
+
+uint32 FLineRendererComponentSceneProxy::GetMemoryFootprint() const
+{
+    return sizeof(*this) + GetAllocatedSize();
+}
+
+uint32 FLineRendererComponentSceneProxy::GetAllocatedSize() const
+{
+    SIZE_T AllocatedSize = FPrimitiveSceneProxy::GetAllocatedSize() + Sections_RenderThread.GetAllocatedSize();
+
+    for (const TSharedPtr<FLineProxySection>& SectionPtr : Sections_RenderThread)
+    {
+        if (SectionPtr.IsValid())
+        {
+            AllocatedSize += sizeof(FLineProxySection) + SectionPtr->GetMemoryWithLODs().LineBytes;
+        }
+    }
+
+    return AllocatedSize;
+}
+
+void FLineRendererComponentSceneProxy::UpdateMeshSection(const FLineSectionInfo* SrcSection)
+{
+    // Builds resources for this section only, the render thread replaces the previous section with the same index
+    AddNewSections_GameThread(MakeArrayView(&SrcSection, 1));
+}
+
+void FLineRendererComponentSceneProxy::UpdateMeshSections(TConstArrayView<const FLineSectionInfo*> SrcSections)
+{
+    AddNewSections_GameThread(SrcSections);
+}
+
+void FLineRendererComponentSceneProxy::UpdateSectionPoints_RenderThread(FRHICommandListBase& RHICmdList, FLineProxySection& Section, int32 StartIndex, TConstArrayView<FVector3f> Points) const
+{
+    check(IsInRenderingThread());
+
+    LINE_RENDERER_SCOPE_CYCLE_COUNTER(STAT_LineRenderer_UpdateSections);
+
+    // Point N is the start of line N and the end of line N - 1, counted from the first line not dropped by ring buffer appends
+    const TArrayView<FPackedLine> Lines = MakeArrayView(Section.Lines).RightChop(Section.FirstLine);
+    const int32 FirstLine = FMath::Max(StartIndex - 1, 0);
+    const int32 LastLine = FMath::Min(StartIndex + Points.Num() - 1, Lines.Num() - 1);
+
+    if (FirstLine > LastLine)
+    {
+        return;
+    }
+
+    for (int32 PointIndex = 0; PointIndex < Points.Num(); ++PointIndex)
+    {
+        const int32 LineIndex = StartIndex + PointIndex;
+        const FVector3f& Point = Points[PointIndex];
+
+        if (LineIndex > Lines.Num())
+        {
+            break;
+        }
+
+        if (LineIndex > 0)
+        {
+            Lines[LineIndex - 1].End.X = Point.X;
+            Lines[LineIndex - 1].End.Y = Point.Y;
+            Lines[LineIndex - 1].End.Z = Point.Z;
+        }
+
+        if (LineIndex < Lines.Num())
+        {
+            Lines[LineIndex].StartAndThickness = FVector4f(Point, Lines[LineIndex].StartAndThickness.W);
+        }
+
+        // Grows only, a conservative box is enough for culling
+        Section.SectionLocalBox += Point;
+    }
+
+    // Buffers and vertex factories are kept, only the expansion is redone
+    ++Section.Revision;
+
+    // Simplified levels no longer match, they are built again once the points stop moving
+    Section.InvalidateLODs();
+
+    if (Section.bGPUExpansion)
+    {
+        Section.SegmentBuffer.Lines = Lines;
+
+        if (Section.SegmentBuffer.IsDynamic())
+        {
+            Section.SegmentBuffer.WriteLines(RHICmdList, Section.SegmentBuffer.FirstLine + FirstLine, Lines.Slice(FirstLine, LastLine - FirstLine + 1));
+        }
+        else
+        {
+            // First move of a section created static, its buffer is created again as dynamic with the moved lines
+            Section.LineVertexFactory.ReleaseResource();
+            Section.SegmentBuffer.ReleaseResource();
+            Section.SegmentBuffer.bDynamic = true;
+
+            InitSection_RenderThread(RHICmdList, Section);
+        }
+    }
+}
+
+void FLineRendererComponentSceneProxy::UpdateMeshSectionPoints(int32 SectionIndex, int32 StartIndex, TConstArrayView<FVector> Points)
+{
+    check(IsInGameThread());
+
+    TArray<FVector3f> LocalPoints;
+    LocalPoints.Reserve(Points.Num());
+
+    for (const FVector& Point : Points)
+    {
+        LocalPoints.Add(FVector3f(Point));
+    }
+
+    ENQUEUE_RENDER_COMMAND(UpdateLineSectionPoints)(
+        [this, SectionIndex, StartIndex, LocalPoints = MoveTemp(LocalPoints)](FRHICommandListImmediate& RHICmdList) mutable
+        {
+            RunAfterPendingSections_RenderThread(RHICmdList, [this, SectionIndex, StartIndex, LocalPoints = MoveTemp(LocalPoints)](FRHICommandListBase& InRHICmdList)
+            {
+                if (const TSharedPtr<FLineProxySection>* Section = Sections_RenderThread.Find(SectionIndex))
+                {
+                    UpdateSectionPoints_RenderThread(InRHICmdList, **Section, StartIndex, LocalPoints);
+                    PublishSectionMemory_RenderThread(**Section);
+                }
+            });
+        }
+    );
+}
+
+void FLineRendererComponentSceneProxy::AppendMeshSectionLines(const FLineSectionInfo* SrcSection, int32 NumNewLines, int32 MaxLines)
+{
+    check(IsInGameThread());
+
+    const int32 SectionIndex = SrcSection->SectionIndex;
+
+    TArray<FPackedLine> PackedLines;
+    PackSectionLines(*SrcSection, FMath::Max(SrcSection->GetNumLines() - NumNewLines, 0), bVertexColor, PackedLines);
+
+    ENQUEUE_RENDER_COMMAND(AppendLineSectionLines)(
+        [this, SectionIndex, PackedLines = MoveTemp(PackedLines), MaxLines](FRHICommandListImmediate& RHICmdList) mutable
+        {
+            RunAfterPendingSections_RenderThread(RHICmdList, [this, SectionIndex, PackedLines = MoveTemp(PackedLines), MaxLines](FRHICommandListBase& InRHICmdList)
+            {
+                if (const TSharedPtr<FLineProxySection>* Section = Sections_RenderThread.Find(SectionIndex))
+                {
+                    AppendSectionLines_RenderThread(InRHICmdList, **Section, PackedLines, MaxLines);
+                    PublishSectionMemory_RenderThread(**Section);
+                }
+            });
+        }
+    );
+}
+
+bool FLineRendererComponentSceneProxy::IsStaticSection(int32 SectionIndex) const
+{
+    check(IsInGameThread());
+
+    return StaticSections_GameThread.Contains(SectionIndex);
+}
+
+bool FLineRendererComponentSceneProxy::HasStaticSections() const
+{
+    return bHasStaticSections;
+}
+
+bool FLineRendererComponentSceneProxy::GetSectionMemoryStats(int32 SectionIndex, FLineSectionMemoryStats& OutStats) const
+{
+    FScopeLock Lock(&SectionMemoryLock);
+
+    const FLineSectionMemoryStats* Stats = SectionMemory.Find(SectionIndex);
+    if (Stats == nullptr)
+    {
+        return false;
+    }
+
+    OutStats = *Stats;
+    return true;
+}
+
+void FLineRendererComponentSceneProxy::ClearMeshSection(int32 SectionIndex)
+{
+    ClearMeshSections(MakeArrayView(&SectionIndex, 1));
+}
+
+void FLineRendererComponentSceneProxy::ClearMeshSections(TConstArrayView<int32> SectionIndices)
+{
+    ENQUEUE_RENDER_COMMAND(ReleaseSectionResources)(
+        [this, SectionIndices = TArray<int32>(SectionIndices)](FRHICommandListImmediate& RHICmdList) mutable
+        {
+            RunAfterPendingSections_RenderThread(RHICmdList, [this, SectionIndices = MoveTemp(SectionIndices)](FRHICommandListBase&)
+            {
+                LINE_RENDERER_SCOPE_CYCLE_COUNTER(STAT_LineRenderer_ReleaseSections);
+
+                FScopeLock Lock(&SectionMemoryLock);
+
+                for (int32 SectionIndex : SectionIndices)
+                {
+                    Sections_RenderThread.Remove(SectionIndex);
+                    SectionMemory.Remove(SectionIndex);
+                }
+            });
+        }
+    );
+}
+
+void FLineRendererComponentSceneProxy::ClearAllMeshSections()
+{
+    ENQUEUE_RENDER_COMMAND(ReleaseAllSectionResources)(
+        [this](FRHICommandListImmediate& RHICmdList)
+        {
+            RunAfterPendingSections_RenderThread(RHICmdList, [this](FRHICommandListBase&)
+            {
+                LINE_RENDERER_SCOPE_CYCLE_COUNTER(STAT_LineRenderer_ReleaseSections);
+
+                Sections_RenderThread.Empty();
+
+                FScopeLock Lock(&SectionMemoryLock);
+                SectionMemory.Empty();
+            });
+        }
+    );
+}
+
+void FLineRendererComponentSceneProxy::SetMeshSectionVisible(int32 SectionIndex, bool bNewVisibility)
+{
+    ENQUEUE_RENDER_COMMAND(SetMeshSectionVisibility)(
+        [this, SectionIndex, bNewVisibility](FRHICommandListImmediate& RHICmdList)
+        {
+            RunAfterPendingSections_RenderThread(RHICmdList, [this, SectionIndex, bNewVisibility](FRHICommandListBase&)
+            {
+                if (const TSharedPtr<FLineProxySection>* Section = Sections_RenderThread.Find(SectionIndex))
+                {
+                    (*Section)->bSectionVisible = bNewVisibility;
+                }
+            });
+        }
+    );
+}
@@ -14,12 +14,28 @@
 #include "SceneView.h"
 #include "Materials/MaterialRelevance.h"
 #include "Components/LineBatchComponent.h"
+#include "LineSectionInfo.h"
+#include "LineSectionSlotMap.h"
+#include "Tasks/Task.h"
+#include "HAL/CriticalSection.h"
 
 
-struct FLineSectionInfo;
 struct FLineSectionUpdateData;
+struct FPackedLine;
 class ULineRendererComponent;
 class FLineProxySection;
+class FLineMergedBatch;
+class FLineInstancedBatch;
+
+/** Sections of one AddNewSections_GameThread call waiting for their build tasks */
+struct FLinePendingSections
+{
+	TArray<TSharedRef<FLineProxySection>> Sections;
+	/** Empty when the sections were built before the render command */
+	TArray<UE::Tasks::FTask> BuildTasks;
+	/** Section commands enqueued after these sections, run in order once they are initialized */
+	TArray<TUniqueFunction<void(FRHICommandListBase&)>> Commands;
+};
 
 class FLineRendererComponentSceneProxy final : public FPrimitiveSceneProxy
 {
@@ -30,6 +46,7 @@ public:
 	SIZE_T GetTypeHash() const override;
 
 	virtual void GetDynamicMeshElements(const TArray<const FSceneView*>& Views, const FSceneViewFamily& ViewFamily, uint32 VisibilityMap, FMeshElementCollector& Collector) const override;
+	virtual void DrawStaticElements(FStaticPrimitiveDrawInterface* PDI) override;
 	virtual FPrimitiveViewRelevance GetViewRelevance(const FSceneView* View) const;
 
 	virtual bool CanBeOccluded() const;
@@ -38,19 +55,75 @@ public:
 
 public: 
     // Accessors for ULineRendererComponent
-	int32 GetNumSections() const;
-	int32 GetNumPointsInSection(int32 SectionIndex) const;
+    void UpdateMeshSection(const FLineSectionInfo* SrcSection);
+    /** Creates or replaces many sections with one render command */
+    void UpdateMeshSections(TConstArrayView<const FLineSectionInfo*> SrcSections);
+    /** Sends only the last NumNewLines lines of a section, the oldest lines beyond MaxLines are dropped when MaxLines > 0 */
+    void AppendMeshSectionLines(const FLineSectionInfo* SrcSection, int32 NumNewLines, int32 MaxLines);
+    /** Moves points of a section in place, all buffers and vertex factories are kept */
+    void UpdateMeshSectionPoints(int32 SectionIndex, int32 StartIndex, TConstArrayView<FVector> Points);
+    /** Copies the memory of a section, false if the section is not known */
+    bool GetSectionMemoryStats(int32 SectionIndex, FLineSectionMemoryStats& OutStats) const;
+    /** Whether the section is drawn through DrawStaticElements, changing such a section requires a new proxy */
+    bool IsStaticSection(int32 SectionIndex) const;
+    bool HasStaticSections() const;
     void ClearMeshSection(int32 SectionIndex);
+    void ClearMeshSections(TConstArrayView<int32> SectionIndices);
     void ClearAllMeshSections();
     void SetMeshSectionVisible(int32 SectionIndex, bool bNewVisibility);
-    bool IsMeshSectionVisible(int32 SectionIndex) const;
 
 private:
-	void AddNewSection_GameThread(const FLineSectionInfo* NewSection);
+	/** Builds the sections on the game thread and initializes all of them with a single render command */
+	void AddNewSections_GameThread(TConstArrayView<const FLineSectionInfo*> SrcSections);
+	/** Copies the lines of a section and sizes its resources, the rest is left to BuildSection_AnyThread */
+	TSharedRef<FLineProxySection> CreateSection_GameThread(const FLineSectionInfo* SrcSection);
+	/** Initializes pending sections in order, stops at the first batch still being built unless bWait */
+	void ResolvePendingSections_RenderThread(FRHICommandListBase& RHICmdList, bool bWait) const;
+	/** Runs a section command right away, or once the pending sections added before it are initialized */
+	void RunAfterPendingSections_RenderThread(FRHICommandListBase& RHICmdList, TUniqueFunction<void(FRHICommandListBase&)>&& Command) const;
+	/** Hands the current memory of a section to the game thread, called whenever its resources change */
+	void PublishSectionMemory_RenderThread(const FLineProxySection& Section) const;
+	void InitSection_RenderThread(FRHICommandListBase& RHICmdList, FLineProxySection& Section) const;
+	void InitStaticSection_RenderThread(FRHICommandListBase& RHICmdList, FLineProxySection& Section) const;
+	/** Reallocates the render resources of a section for NewCapacity lines */
+	void ResizeSection_RenderThread(FRHICommandListBase& RHICmdList, FLineProxySection& Section, int32 NewCapacity) const;
+	void AppendSectionLines_RenderThread(FRHICommandListBase& RHICmdList, FLineProxySection& Section, TConstArrayView<FPackedLine> NewLines, int32 MaxLines) const;
+	void UpdateSectionPoints_RenderThread(FRHICommandListBase& RHICmdList, FLineProxySection& Section, int32 StartIndex, TConstArrayView<FVector3f> Points) const;
 
 private:
 	ULineRendererComponent* Component;
 	FMaterialRelevance MaterialRelevance;
+	/** Whether sections are expanded on the GPU by FLineVertexFactory */
+	bool bGPUExpansion;
+	/** Whether line colors are written to the vertex color stream */
+	bool bVertexColor;
+	/** Geometry every line is expanded into */
+	ELineGeometryMode GeometryMode;
+	/** Whether world space sections are built once and drawn from DrawStaticElements */
+	bool bStaticLines;
+	/** Whether any section was created static, fixed for the lifetime of the proxy */
+	bool bHasStaticSections;
+	/** Whether any section drawn by GetDynamicMeshElements was added, only ever set */
+	bool bHasDynamicSections_RenderThread;
+	/** Whether new sections are drawn once built on worker tasks or built before the game thread moves on */
+	ELineSectionBuildMode SectionBuildMode;
+
+	/** Sections by section index, contiguous for iteration. Sections hold render resources and are not moved, only their pointers are */
+	mutable TLineSectionSlotMap<TSharedPtr<FLineProxySection>> Sections_RenderThread;
+	/** Batches of new sections in the order they were added, see ResolvePendingSections_RenderThread */
+	mutable TArray<FLinePendingSections> PendingSections_RenderThread;
+	/** Released by the destructor, render commands enqueued from build tasks only resolve sections while it is alive */
+	TSharedPtr<bool, ESPMode::ThreadSafe> LifetimeToken;
+
+	/** Vertex buffers of sections drawn together, by material. Rebuilt from GetDynamicMeshElements */
+	mutable TMap<const FMaterialRenderProxy*, TSharedPtr<FLineMergedBatch>> MergedBatches_RenderThread;
+	/** Segment buffers of GPU expanded sections drawn together, by material. Rebuilt from GetDynamicMeshElements */
+	mutable TMap<const FMaterialRenderProxy*, TSharedPtr<FLineInstancedBatch>> InstancedBatches_RenderThread;
 
-	TMap<int32, TSharedPtr<FLineProxySection>> Sections_RenderThread;
+	/** Memory of each section and its simplified levels, estimated by CreateSection_GameThread and updated by the render thread as resources change */
+	mutable TMap<int32, FLineSectionMemoryStats> SectionMemory;
+	/** Guards SectionMemory, which the game thread reads while the render thread resizes sections */
+	mutable FCriticalSection SectionMemoryLock;
+	/** Sections created static, see IsStaticSection */
+	TSet<int32> StaticSections_GameThread;
 };
\ No newline at end of file
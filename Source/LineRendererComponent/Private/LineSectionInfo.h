@@ -1,27 +1,135 @@
-// Copyright 2023 Petr Leontev. All Rights Reserved.
-
-#pragma once
-
-#include "CoreMinimal.h"
-#include "Components/LineBatchComponent.h"
-#include "Math/Color.h"
-#include "LineSectionInfo.generated.h"
-
-class UMaterialInterface;
-
-/* Line section description */
-
-USTRUCT()
-struct FLineSectionInfo
-{
-    GENERATED_BODY()
-
-public:
-    int32 SectionIndex;
-    bool bScreenSpace;
-    TArray<FBatchedLine> Lines;
-    FLinearColor Color;
-
-    UPROPERTY()
-    UMaterialInterface* Material;
-};
+// Copyright 2023 Petr Leontev. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/LineBatchComponent.h"
+#include "Math/Color.h"
+#include "LineSectionInfo.generated.h"
+
+class UMaterialInterface;
+
+/* Geometry every line segment is expanded into */
+
+UENUM(BlueprintType)
+enum class ELineGeometryMode : uint8
+{
+    /** Two camera facing end caps and two crossing quads, 24 vertices. Keeps thickness from any angle */
+    Caps,
+    /** One quad facing the camera around the line axis, 4 vertices and 6 indices. Enough for thin lines */
+    Ribbon,
+    /** Ribbons of connected segments meet at mitered joints, beveled past the miter limit. No end caps, no overlap at joints */
+    Strip
+};
+
+UENUM(BlueprintType)
+enum class ELineSectionBuildMode : uint8
+{
+    /** The game thread waits for new sections to be built, they are drawn the next frame */
+    BlockUntilReady,
+    /** New sections are built on worker tasks while the game thread moves on and drawn from the first frame after they are done */
+    ShowWhenReady
+};
+
+/* Memory used by a line section */
+
+struct FLineSectionMemoryStats
+{
+    /** GPU position buffer, or segment buffer when expanded on the GPU */
+    SIZE_T VertexBytes = 0;
+    /** GPU index buffer */
+    SIZE_T IndexBytes = 0;
+    /** GPU tangents and texture coordinates */
+    SIZE_T UVBytes = 0;
+    /** GPU vertex colors */
+    SIZE_T ColorBytes = 0;
+    /** CPU line storage */
+    SIZE_T LineBytes = 0;
+
+    SIZE_T GetGPUBytes() const
+    {
+        return VertexBytes + IndexBytes + UVBytes + ColorBytes;
+    }
+
+    FLineSectionMemoryStats& operator+=(const FLineSectionMemoryStats& Other)
+    {
+        VertexBytes += Other.VertexBytes;
+        IndexBytes += Other.IndexBytes;
+        UVBytes += Other.UVBytes;
+        ColorBytes += Other.ColorBytes;
+        LineBytes += Other.LineBytes;
+        return *this;
+    }
+};
+
+/* Input of the bulk line API, one polyline per section */
+
+USTRUCT(BlueprintType)
+struct FLineSectionDescription
+{
+    GENERATED_BODY()
+
+public:
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Components|LineRenderer")
+    int32 SectionIndex = 0;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Components|LineRenderer")
+    TArray<FVector> Vertices;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Components|LineRenderer")
+    FLinearColor Color = FLinearColor::White;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Components|LineRenderer")
+    float Thickness = 1.0f;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Components|LineRenderer")
+    bool bScreenSpace = false;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Components|LineRenderer")
+    bool bVisible = true;
+};
+
+/* Line section description */
+
+USTRUCT()
+struct FLineSectionInfo
+{
+    GENERATED_BODY()
+
+public:
+    int32 SectionIndex;
+    bool bScreenSpace;
+    /** Polyline points relative to the component, line i runs from point i to point i + 1 of GetPoints() */
+    TArray<FVector3f> Points;
+    /** Points before this one were dropped by ring buffer appends, they are compacted away once they outnumber the others */
+    int32 FirstPoint = 0;
+    /** Color of every line of this section */
+    FLinearColor Color;
+    /** Thickness of every line of this section */
+    float Thickness = 1.0f;
+    /** Kept here so that visibility survives scene proxy recreation */
+    bool bVisible = true;
+    /** Line endpoints grown by their thickness, kept up to date with Points by ULineRendererComponent */
+    FBox LocalBox = FBox(ForceInit);
+
+    /** Material instance owned by this section, or LineMaterial when colors are vertex colors */
+    UPROPERTY()
+    UMaterialInterface* Material;
+
+public:
+    /** Points of the polyline, without the ones dropped by ring buffer appends */
+    TConstArrayView<FVector3f> GetPoints() const
+    {
+        return TConstArrayView<FVector3f>(Points).RightChop(FirstPoint);
+    }
+
+    int32 GetNumPoints() const
+    {
+        return Points.Num() - FirstPoint;
+    }
+
+    int32 GetNumLines() const
+    {
+        return FMath::Max(GetNumPoints() - 1, 0);
+    }
+};
@@ -0,0 +1,170 @@
+// Copyright 2023 Petr Leontev. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/** Generation checked reference to a section of a TLineSectionSlotMap, stale once the section is removed or replaced */
+struct FLineSectionHandle
+{
+    int32 SlotIndex = INDEX_NONE;
+    uint32 Generation = 0;
+
+    bool IsValid() const
+    {
+        return SlotIndex != INDEX_NONE;
+    }
+
+    bool operator==(const FLineSectionHandle& Other) const
+    {
+        return SlotIndex == Other.SlotIndex && Generation == Other.Generation;
+    }
+
+    bool operator!=(const FLineSectionHandle& Other) const
+    {
+        return !(*this == Other);
+    }
+};
+
+/**
+ * Sections stored back to back for iteration, with O(1) add and remove: the last section is swapped into the hole.
+ * Slots map handles to dense indices across swaps, their generation tells a removed section apart from the next one in the slot.
+ * Section indices of the public API are mapped to handles with a single hash lookup.
+ */
+template<typename ValueType>
+class TLineSectionSlotMap
+{
+public:
+    /** Adds the section under Key, a section already there is removed and its handles become stale */
+    FLineSectionHandle Add(int32 Key, ValueType&& Value)
+    {
+        Remove(Key);
+
+        const int32 SlotIndex = FreeSlots.Num() > 0 ? FreeSlots.Pop() : Slots.AddDefaulted();
+
+        FSlot& Slot = Slots[SlotIndex];
+        Slot.DenseIndex = Values.Num();
+
+        Values.Add(MoveTemp(Value));
+        DenseSlots.Add(SlotIndex);
+
+        FLineSectionHandle Handle;
+        Handle.SlotIndex = SlotIndex;
+        Handle.Generation = Slot.Generation;
+
+        KeyToHandle.Add(Key, Handle);
+
+        return Handle;
+    }
+
+    bool Remove(int32 Key)
+    {
+        FLineSectionHandle Handle;
+        if (!KeyToHandle.RemoveAndCopyValue(Key, Handle))
+        {
+            return false;
+        }
+
+        FSlot& Slot = Slots[Handle.SlotIndex];
+        const int32 DenseIndex = Slot.DenseIndex;
+        const int32 LastIndex = Values.Num() - 1;
+
+        if (DenseIndex != LastIndex)
+        {
+            Slots[DenseSlots[LastIndex]].DenseIndex = DenseIndex;
+        }
+
+        Values.RemoveAtSwap(DenseIndex);
+        DenseSlots.RemoveAtSwap(DenseIndex);
+
+        ++Slot.Generation;
+        Slot.DenseIndex = INDEX_NONE;
+        FreeSlots.Add(Handle.SlotIndex);
+
+        return true;
+    }
+
+    void Empty()
+    {
+        // Generations are kept, handles taken before stay stale
+        for (int32 SlotIndex : DenseSlots)
+        {
+            ++Slots[SlotIndex].Generation;
+            Slots[SlotIndex].DenseIndex = INDEX_NONE;
+            FreeSlots.Add(SlotIndex);
+        }
+
+        Values.Empty();
+        DenseSlots.Empty();
+        KeyToHandle.Empty();
+    }
+
+    FLineSectionHandle GetHandle(int32 Key) const
+    {
+        const FLineSectionHandle* Handle = KeyToHandle.Find(Key);
+        return Handle != nullptr ? *Handle : FLineSectionHandle();
+    }
+
+    ValueType* Find(FLineSectionHandle Handle)
+    {
+        if (!Slots.IsValidIndex(Handle.SlotIndex) || Slots[Handle.SlotIndex].Generation != Handle.Generation)
+        {
+            return nullptr;
+        }
+
+        return &Values[Slots[Handle.SlotIndex].DenseIndex];
+    }
+
+    const ValueType* Find(FLineSectionHandle Handle) const
+    {
+        return const_cast<TLineSectionSlotMap*>(this)->Find(Handle);
+    }
+
+    ValueType* Find(int32 Key)
+    {
+        return Find(GetHandle(Key));
+    }
+
+    const ValueType* Find(int32 Key) const
+    {
+        return Find(GetHandle(Key));
+    }
+
+    bool Contains(int32 Key) const
+    {
+        return KeyToHandle.Contains(Key);
+    }
+
+    int32 Num() const
+    {
+        return Values.Num();
+    }
+
+    SIZE_T GetAllocatedSize() const
+    {
+        return Values.GetAllocatedSize() + DenseSlots.GetAllocatedSize() + Slots.GetAllocatedSize() + FreeSlots.GetAllocatedSize() + KeyToHandle.GetAllocatedSize();
+    }
+
+    /** Live sections in no particular order, removing one moves the last section into its place */
+    typename TArray<ValueType>::RangedForIteratorType begin() { return Values.begin(); }
+    typename TArray<ValueType>::RangedForIteratorType end() { return Values.end(); }
+    typename TArray<ValueType>::RangedForConstIteratorType begin() const { return Values.begin(); }
+    typename TArray<ValueType>::RangedForConstIteratorType end() const { return Values.end(); }
+
+private:
+    struct FSlot
+    {
+        /** Index of the section in Values, INDEX_NONE while the slot is free */
+        int32 DenseIndex = INDEX_NONE;
+        /** Incremented whenever the section of this slot is removed */
+        uint32 Generation = 0;
+    };
+
+    /** Live sections, contiguous */
+    TArray<ValueType> Values;
+    /** Slot of each live section, parallel to Values */
+    TArray<int32> DenseSlots;
+    TArray<FSlot> Slots;
+    TArray<int32> FreeSlots;
+    TMap<int32, FLineSectionHandle> KeyToHandle;
+};
@@ -0,0 +1,183 @@
+// Copyright 2023 Petr Leontev. All Rights Reserved.
+
+#include "LineSimplification.h"
+
+
+/** Distance of Point to the segment from Start to End */
+static float GetPointSegmentDistance(const FVector3f& Point, const FVector3f& Start, const FVector3f& End)
+{
+    const FVector3f Segment = End - Start;
+    const float SegmentSizeSquared = Segment.SizeSquared();
+
+    if (SegmentSizeSquared <= UE_SMALL_NUMBER)
+    {
+        return FVector3f::Dist(Point, Start);
+    }
+
+    const float Alpha = FMath::Clamp(FVector3f::DotProduct(Point - Start, Segment) / SegmentSizeSquared, 0.0f, 1.0f);
+    return FVector3f::Dist(Point, Start + Segment * Alpha);
+}
+
+/** Marks the points of one run to keep, OutKeep[0] and the last point are always kept. Returns the largest distance of a dropped point */
+static float SimplifyRun(TConstArrayView<FVector3f> Points, float Tolerance, TArray<bool>& OutKeep)
+{
+    const int32 NumPoints = Points.Num();
+
+    OutKeep.Reset();
+    OutKeep.SetNumZeroed(NumPoints);
+    OutKeep[0] = true;
+    OutKeep[NumPoints - 1] = true;
+
+    float MaxDroppedError = 0.0f;
+
+    // Explicit stack, tracks of many thousands of points would overflow a recursive version
+    TArray<TPair<int32, int32>, TInlineAllocator<64>> Ranges;
+    Ranges.Emplace(0, NumPoints - 1);
+
+    while (Ranges.Num() > 0)
+    {
+        const TPair<int32, int32> Range = Ranges.Pop(false);
+
+        float MaxDistance = -1.0f;
+        int32 MaxIndex = INDEX_NONE;
+
+        for (int32 Index = Range.Key + 1; Index < Range.Value; ++Index)
+        {
+            const float Distance = GetPointSegmentDistance(Points[Index], Points[Range.Key], Points[Range.Value]);
+            if (Distance > MaxDistance)
+            {
+                MaxDistance = Distance;
+                MaxIndex = Index;
+            }
+        }
+
+        if (MaxIndex == INDEX_NONE)
+        {
+            continue;
+        }
+
+        if (MaxDistance > Tolerance)
+        {
+            OutKeep[MaxIndex] = true;
+            Ranges.Emplace(Range.Key, MaxIndex);
+            Ranges.Emplace(MaxIndex, Range.Value);
+        }
+        else
+        {
+            MaxDroppedError = FMath::Max(MaxDroppedError, MaxDistance);
+        }
+    }
+
+    return MaxDroppedError;
+}
+
+/** Appends the lines between kept points of the run starting at FirstLine. Thickness is the largest of the merged lines, color is the one of the first */
+static void AppendSimplifiedRun(TConstArrayView<FPackedLine> Lines, int32 FirstLine, TConstArrayView<FVector3f> Points, const TArray<bool>& Keep, TArray<FPackedLine>& OutLines)
+{
+    int32 StartPoint = 0;
+
+    for (int32 PointIndex = 1; PointIndex < Points.Num(); ++PointIndex)
+    {
+        if (!Keep[PointIndex])
+        {
+            continue;
+        }
+
+        FPackedLine Line = Lines[FirstLine + StartPoint];
+
+        float Thickness = 0.0f;
+        for (int32 LineIndex = FirstLine + StartPoint; LineIndex < FirstLine + PointIndex; ++LineIndex)
+        {
+            Thickness = FMath::Max(Thickness, Lines[LineIndex].StartAndThickness.W);
+        }
+
+        Line.StartAndThickness = FVector4f(Points[StartPoint], Thickness);
+        Line.End.X = Points[PointIndex].X;
+        Line.End.Y = Points[PointIndex].Y;
+        Line.End.Z = Points[PointIndex].Z;
+
+        OutLines.Add(Line);
+
+        StartPoint = PointIndex;
+    }
+}
+
+void BuildLineLODs(TConstArrayView<FPackedLine> Lines, TArray<FLineLOD>& OutLODs)
+{
+    OutLODs.Reset();
+
+    if (Lines.Num() < LineLODMinLines)
+    {
+        return;
+    }
+
+    // Runs of joined lines as point lists
+    TArray<int32> RunFirstLines;
+    TArray<FVector3f> Points;
+    TArray<int32> RunFirstPoints;
+
+    FBox3f Box(EForceInit::ForceInitToZero);
+
+    for (int32 LineIndex = 0; LineIndex < Lines.Num(); ++LineIndex)
+    {
+        if (!IsJoinedToPreviousLine(Lines, LineIndex))
+        {
+            RunFirstLines.Add(LineIndex);
+            RunFirstPoints.Add(Points.Num());
+            Points.Add(FVector3f(Lines[LineIndex].StartAndThickness));
+        }
+
+        Points.Add(FVector3f(Lines[LineIndex].End));
+
+        Box += FVector3f(Lines[LineIndex].StartAndThickness);
+        Box += FVector3f(Lines[LineIndex].End);
+    }
+
+    RunFirstPoints.Add(Points.Num());
+
+    // Disjoint lines cannot be simplified
+    if (RunFirstLines.Num() == Lines.Num())
+    {
+        return;
+    }
+
+    // Tolerance doubles every level, starting from a fraction of the section size
+    float Tolerance = Box.GetSize().GetMax() / 4096.0f;
+    if (Tolerance <= 0.0f)
+    {
+        return;
+    }
+
+    TArray<bool> Keep;
+    int32 PreviousNumLines = Lines.Num();
+
+    for (int32 Step = 0; Step < 2 * MaxLineLODs && OutLODs.Num() < MaxLineLODs; ++Step, Tolerance *= 2.0f)
+    {
+        FLineLOD LOD;
+        LOD.Lines.Reserve(PreviousNumLines);
+
+        for (int32 RunIndex = 0; RunIndex < RunFirstLines.Num(); ++RunIndex)
+        {
+            const TConstArrayView<FVector3f> RunPoints(Points.GetData() + RunFirstPoints[RunIndex], RunFirstPoints[RunIndex + 1] - RunFirstPoints[RunIndex]);
+
+            LOD.Error = FMath::Max(LOD.Error, SimplifyRun(RunPoints, Tolerance, Keep));
+            AppendSimplifiedRun(Lines, RunFirstLines[RunIndex], RunPoints, Keep, LOD.Lines);
+        }
+
+        // Levels have to be worth their memory, each one draws at most 3/4 of the lines of the previous one
+        if (LOD.Lines.Num() * 4 > PreviousNumLines * 3)
+        {
+            continue;
+        }
+
+        PreviousNumLines = LOD.Lines.Num();
+        LOD.Lines.Shrink();
+        OutLODs.Add(MoveTemp(LOD));
+
+        // Every run is down to a single line
+        if (PreviousNumLines == RunFirstLines.Num())
+        {
+            break;
+        }
+    }
+}
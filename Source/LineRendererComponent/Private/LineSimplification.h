@@ -0,0 +1,31 @@
+// Copyright 2023 Petr Leontev. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "LineVertexExpansion.h"
+
+/* Level of detail of long polylines */
+
+/** Sections with fewer lines are always drawn at full resolution */
+static constexpr int32 LineLODMinLines = 64;
+
+/** Upper bound of the number of simplified levels of a section */
+static constexpr int32 MaxLineLODs = 8;
+
+/** Simplified lines of a section */
+struct FLineLOD
+{
+    /** Kept lines, every point is one of the original points */
+    TArray<FPackedLine> Lines;
+    /** Largest distance of a dropped point to the simplified line, in local units */
+    float Error = 0.0f;
+};
+
+/**
+ * Builds simplified levels of Lines with Douglas-Peucker, ordered from finest to coarsest.
+ * Each run of joined lines is simplified on its own so that strips keep their joints and gaps.
+ * Levels that do not remove enough lines from the previous one are skipped, OutLODs stays empty for short sections.
+ * Does not touch any engine state, meant to run on a worker thread.
+ */
+void BuildLineLODs(TConstArrayView<FPackedLine> Lines, TArray<FLineLOD>& OutLODs);
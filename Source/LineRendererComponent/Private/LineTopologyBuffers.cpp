@@ -0,0 +1,117 @@
+// Copyright 2023 Petr Leontev. All Rights Reserved.
+
+#include "LineTopologyBuffers.h"
+#include "HAL/ThreadSafeCounter64.h"
+#include "RenderingThread.h"
+#include "Runtime/Launch/Resources/Version.h"
+#include "LineVertexExpansion.h"
+
+/** Texture coordinates of the line vertex pattern: begin cap, end cap, first and second crossing quads */
+static const FVector2f LineTexCoords[NumVerticesPerLine] =
+{
+    FVector2f(1, 0), FVector2f(1, 1), FVector2f(0, 0),  FVector2f(1, 1), FVector2f(0, 0), FVector2f(0, 1),
+    FVector2f(1, 0), FVector2f(1, 1), FVector2f(0, 0),  FVector2f(1, 1), FVector2f(0, 0), FVector2f(0, 1),
+    FVector2f(0, 0), FVector2f(1, 1), FVector2f(0, 0),  FVector2f(1, 1), FVector2f(1, 1), FVector2f(0, 0),
+    FVector2f(0, 1), FVector2f(1, 0), FVector2f(0, 1),  FVector2f(1, 0), FVector2f(1, 0), FVector2f(0, 1)
+};
+
+/** Texture coordinates of a ribbon: U along the line, V across it */
+static const FVector2f RibbonTexCoords[NumVerticesPerRibbonLine] =
+{
+    FVector2f(0, 0), FVector2f(0, 1), FVector2f(1, 0), FVector2f(1, 1)
+};
+
+/** Ribbon quad, same winding as the caps */
+static const uint32 RibbonIndices[NumIndicesPerRibbonLine] =
+{
+    0, 2, 1,  1, 2, 3
+};
+
+/** Smallest number of lines allocated, avoids regrowing for many small sections */
+static constexpr int32 MinTopologyLines = 64;
+
+/** Largest buffers created so far per geometry mode, only accessed on the render thread */
+static TWeakPtr<FLineTopologyBuffers> CurrentTopology[2];
+
+static FThreadSafeCounter64 TotalTopologyBytes;
+
+FLineTopologyBuffers::FLineTopologyBuffers(FRHICommandListBase& RHICmdList, ELineGeometryMode InMode, int32 InNumLines)
+    : NumLines(InNumLines)
+    , AllocatedBytes(0)
+{
+    const bool bRibbon = InMode == ELineGeometryMode::Ribbon;
+
+    const int32 VerticesPerLine = GetNumVerticesPerLine(InMode);
+    const int32 NumVerts = NumLines * VerticesPerLine;
+
+    StaticMeshVertexBuffer.Init(NumVerts, 1, false);
+
+    for (int32 VertexIndex = 0; VertexIndex < NumVerts; ++VertexIndex)
+    {
+        const int32 LineVertex = VertexIndex % VerticesPerLine;
+
+        StaticMeshVertexBuffer.SetVertexUV(VertexIndex, 0, bRibbon ? RibbonTexCoords[LineVertex] : LineTexCoords[LineVertex]);
+        StaticMeshVertexBuffer.SetVertexTangents(VertexIndex, FVector3f::UpVector, FVector3f::RightVector, FVector3f::ForwardVector);
+    }
+
+    const int32 IndicesPerLine = GetNumIndicesPerLine(InMode);
+
+    TArray<uint32> Indices;
+    Indices.SetNumUninitialized(NumLines * IndicesPerLine);
+
+    for (int32 Index = 0; Index < Indices.Num(); ++Index)
+    {
+        Indices[Index] = bRibbon ? (Index / IndicesPerLine) * VerticesPerLine + RibbonIndices[Index % IndicesPerLine] : Index;
+    }
+
+    IndexBuffer.SetIndices(Indices, EIndexBufferStride::AutoDetect);
+
+    AllocatedBytes = IndexBuffer.GetIndexDataSize() + StaticMeshVertexBuffer.GetResourceSize();
+    TotalTopologyBytes.Add(AllocatedBytes);
+
+#if ENGINE_MAJOR_VERSION > 4 && ENGINE_MINOR_VERSION > 3
+    IndexBuffer.InitResource(RHICmdList);
+    StaticMeshVertexBuffer.InitResource(RHICmdList);
+#else
+    IndexBuffer.InitResource();
+    StaticMeshVertexBuffer.InitResource();
+#endif
+}
+
+FLineTopologyBuffers::~FLineTopologyBuffers()
+{
+    TotalTopologyBytes.Subtract(AllocatedBytes);
+
+    IndexBuffer.ReleaseResource();
+    StaticMeshVertexBuffer.ReleaseResource();
+}
+
+TSharedRef<FLineTopologyBuffers> FLineTopologyBuffers::Get(FRHICommandListBase& RHICmdList, ELineGeometryMode Mode, int32 InNumLines)
+{
+    check(IsInRenderingThread());
+
+    // Strips share the ribbon vertex layout, their indices depend on the lines and are built per section
+    if (Mode == ELineGeometryMode::Strip)
+    {
+        Mode = ELineGeometryMode::Ribbon;
+    }
+
+    TWeakPtr<FLineTopologyBuffers>& ModeTopology = CurrentTopology[(int32)Mode];
+
+    TSharedPtr<FLineTopologyBuffers> Topology = ModeTopology.Pin();
+
+    if (!Topology.IsValid() || Topology->GetNumLines() < InNumLines)
+    {
+        const int32 NewNumLines = FMath::Max<int32>((int32)FMath::RoundUpToPowerOfTwo(FMath::Max(InNumLines, MinTopologyLines)), Topology.IsValid() ? Topology->GetNumLines() * 2 : 0);
+
+        Topology = MakeShareable(new FLineTopologyBuffers(RHICmdList, Mode, NewNumLines));
+        ModeTopology = Topology;
+    }
+
+    return Topology.ToSharedRef();
+}
+
+SIZE_T FLineTopologyBuffers::GetTotalAllocatedBytes()
+{
+    return TotalTopologyBytes.GetValue();
+}
@@ -0,0 +1,50 @@
+// Copyright 2023 Petr Leontev. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "RawIndexBuffer.h"
+#include "Rendering/StaticMeshVertexBuffer.h"
+#include "Templates/SharedPointer.h"
+#include "LineSectionInfo.h"
+
+class FRHICommandListBase;
+
+/**
+ * Index buffer and UV/tangent buffer of the line vertex pattern of one geometry mode, which is the same for every line.
+ * Shared by all sections and components that fit into them, a section binds the vertices and indices of its first NumLines lines.
+ * Grows on demand: a larger request creates new buffers, older ones are released with the last section using them.
+ */
+class FLineTopologyBuffers
+{
+public:
+    ~FLineTopologyBuffers();
+
+    /** Returns shared buffers holding at least NumLines lines of the given mode, ribbon buffers for strips. Render thread only */
+    static TSharedRef<FLineTopologyBuffers> Get(FRHICommandListBase& RHICmdList, ELineGeometryMode Mode, int32 NumLines);
+
+    /** GPU memory of all live topology buffers */
+    static SIZE_T GetTotalAllocatedBytes();
+
+    int32 GetNumLines() const
+    {
+        return NumLines;
+    }
+
+    SIZE_T GetAllocatedBytes() const
+    {
+        return AllocatedBytes;
+    }
+
+    /** Sequential indices for caps, two triangles per quad for ribbons. Lines are not sharing vertices */
+    FRawStaticIndexBuffer IndexBuffer;
+
+    /** UVs and tangents of every line vertex */
+    FStaticMeshVertexBuffer StaticMeshVertexBuffer;
+
+private:
+    FLineTopologyBuffers(FRHICommandListBase& RHICmdList, ELineGeometryMode InMode, int32 InNumLines);
+
+    int32 NumLines;
+    SIZE_T AllocatedBytes;
+};
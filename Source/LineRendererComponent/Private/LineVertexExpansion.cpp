@@ -0,0 +1,461 @@
+// Copyright 2023 Petr Leontev. All Rights Reserved.
+
+#include "LineVertexExpansion.h"
+#include "Async/ParallelFor.h"
+#include "HAL/IConsoleManager.h"
+#include "Math/VectorRegister.h"
+
+
+static TAutoConsoleVariable<int32> CVarLineRendererParallelExpansionBatchSize(
+    TEXT("r.LineRenderer.ParallelExpansionBatchSize"),
+    2048,
+    TEXT("Number of lines expanded by one ParallelFor worker. Sections with fewer lines are expanded on the calling thread.\n")
+    TEXT(" 0: never expand in parallel"),
+    ECVF_RenderThreadSafe);
+
+/** Start or end point (bit 2) and corner (bits 0-1) of every vertex of a line, same table as in LineVertexFactory.ush */
+static const uint8 LineCornerTable[NumVerticesPerLine] =
+{
+    0, 1, 2,  1, 2, 3,
+    4, 5, 6,  5, 6, 7,
+    2, 1, 6,  1, 5, 6,
+    3, 0, 7,  0, 4, 7
+};
+
+/** End point (bit 1) and side (bit 0) of every non-indexed ribbon vertex, in the order of the ribbon index buffer */
+static const uint8 RibbonCornerTable[NumIndicesPerRibbonLine] =
+{
+    0, 2, 1,  1, 2, 3
+};
+
+FLineExpansionView::FLineExpansionView(const FMatrix& WorldToClip, const FMatrix& ClipToWorld, const FMatrix& ProjectionMatrix, uint32 InViewportSizeX)
+    : CameraX(ClipToWorld.TransformVector(FVector(1, 0, 0)).GetSafeNormal())
+    , CameraY(ClipToWorld.TransformVector(FVector(0, 1, 0)).GetSafeNormal())
+    , CameraZ(CameraX ^ CameraY)
+    , ClipW(WorldToClip.M[0][3], WorldToClip.M[1][3], WorldToClip.M[2][3], WorldToClip.M[3][3])
+    , ViewportSizeX(InViewportSizeX)
+    , OrthoZoomFactor(1.0f)
+{
+    const bool bIsPerspective = ProjectionMatrix.M[3][3] < 1.0f;
+    if (!bIsPerspective)
+    {
+        OrthoZoomFactor = 1.0f / ProjectionMatrix.M[0][0];
+    }
+}
+
+FLineExpansionView FLineExpansionView::GetStereoMidpoint(const FLineExpansionView& Left, const FLineExpansionView& Right)
+{
+    // Eyes are offset along camera right, their axes are parallel or slightly canted
+    FLineExpansionView Midpoint = Left;
+    Midpoint.CameraX = (Left.CameraX + Right.CameraX).GetSafeNormal();
+    Midpoint.CameraY = (Left.CameraY + Right.CameraY).GetSafeNormal();
+    Midpoint.CameraZ = Midpoint.CameraX ^ Midpoint.CameraY;
+    Midpoint.ClipW = (Left.ClipW + Right.ClipW) * 0.5;
+    Midpoint.OrthoZoomFactor = (Left.OrthoZoomFactor + Right.OrthoZoomFactor) * 0.5f;
+
+    return Midpoint;
+}
+
+static void ExpandLineVerticesRange(const FLineExpansionView& View, bool bScreenSpace, const FPackedLine* Lines, int32 NumLines, FVector3f* OutVertices)
+{
+    const VectorRegister4Float CameraX = VectorLoadFloat3_W0(&View.CameraX.X);
+    const VectorRegister4Float CameraY = VectorLoadFloat3_W0(&View.CameraY.X);
+
+    const float CurrentOrthoZoomFactor = bScreenSpace ? View.OrthoZoomFactor : 1.0f;
+    const float ScreenSpaceScaling = bScreenSpace ? 2.0f : 1.0f;
+
+    for (int32 LineIndex = 0; LineIndex < NumLines; ++LineIndex)
+    {
+        const FPackedLine& Line = Lines[LineIndex];
+        const float Thickness = Line.StartAndThickness.W;
+
+        // Only clip W is needed, computed in double precision from the view matrix
+        const float StartW = View.ClipW.X * Line.StartAndThickness.X + View.ClipW.Y * Line.StartAndThickness.Y + View.ClipW.Z * Line.StartAndThickness.Z + View.ClipW.W;
+        const float EndW = View.ClipW.X * Line.End.X + View.ClipW.Y * Line.End.Y + View.ClipW.Z * Line.End.Z + View.ClipW.W;
+
+        const float ScalingStart = bScreenSpace ? StartW / View.ViewportSizeX : 1.0f;
+        const float ScalingEnd = bScreenSpace ? EndW / View.ViewportSizeX : 1.0f;
+
+        const float StartThickness = Thickness * ScreenSpaceScaling * CurrentOrthoZoomFactor * ScalingStart;
+        const float EndThickness = Thickness * ScreenSpaceScaling * CurrentOrthoZoomFactor * ScalingEnd;
+
+        const VectorRegister4Float Start = VectorLoad(&Line.StartAndThickness.X);
+        // End.W holds color bits, which must not take part in the arithmetic
+        const VectorRegister4Float End = VectorLoadFloat3_W0(&Line.End.X);
+
+        const VectorRegister4Float HalfStart = VectorSetFloat1(StartThickness * 0.5f);
+        const VectorRegister4Float HalfEnd = VectorSetFloat1(EndThickness * 0.5f);
+
+        const VectorRegister4Float XS = VectorMultiply(CameraX, HalfStart);
+        const VectorRegister4Float YS = VectorMultiply(CameraY, HalfStart);
+        const VectorRegister4Float XE = VectorMultiply(CameraX, HalfEnd);
+        const VectorRegister4Float YE = VectorMultiply(CameraY, HalfEnd);
+
+        // Corners of the start and end caps
+        const VectorRegister4Float S0 = VectorSubtract(VectorAdd(Start, XS), YS);
+        const VectorRegister4Float S1 = VectorAdd(VectorAdd(Start, XS), YS);
+        const VectorRegister4Float S2 = VectorSubtract(VectorSubtract(Start, XS), YS);
+        const VectorRegister4Float S3 = VectorAdd(VectorSubtract(Start, XS), YS);
+
+        const VectorRegister4Float E0 = VectorSubtract(VectorAdd(End, XE), YE);
+        const VectorRegister4Float E1 = VectorAdd(VectorAdd(End, XE), YE);
+        const VectorRegister4Float E2 = VectorSubtract(VectorSubtract(End, XE), YE);
+        const VectorRegister4Float E3 = VectorAdd(VectorSubtract(End, XE), YE);
+
+        float* Out = &OutVertices[LineIndex * NumVerticesPerLine].X;
+
+        // Begin point
+        VectorStoreFloat3(S0, Out + 0 * 3);
+        VectorStoreFloat3(S1, Out + 1 * 3);
+        VectorStoreFloat3(S2, Out + 2 * 3);
+
+        VectorStoreFloat3(S1, Out + 3 * 3);
+        VectorStoreFloat3(S2, Out + 4 * 3);
+        VectorStoreFloat3(S3, Out + 5 * 3);
+
+        // Ending point
+        VectorStoreFloat3(E0, Out + 6 * 3);
+        VectorStoreFloat3(E1, Out + 7 * 3);
+        VectorStoreFloat3(E2, Out + 8 * 3);
+
+        VectorStoreFloat3(E1, Out + 9 * 3);
+        VectorStoreFloat3(E2, Out + 10 * 3);
+        VectorStoreFloat3(E3, Out + 11 * 3);
+
+        // First part of line
+        VectorStoreFloat3(S2, Out + 12 * 3);
+        VectorStoreFloat3(S1, Out + 13 * 3);
+        VectorStoreFloat3(E2, Out + 14 * 3);
+
+        VectorStoreFloat3(S1, Out + 15 * 3);
+        VectorStoreFloat3(E1, Out + 16 * 3);
+        VectorStoreFloat3(E2, Out + 17 * 3);
+
+        // Second part of line
+        VectorStoreFloat3(S3, Out + 18 * 3);
+        VectorStoreFloat3(S0, Out + 19 * 3);
+        VectorStoreFloat3(E3, Out + 20 * 3);
+
+        VectorStoreFloat3(S0, Out + 21 * 3);
+        VectorStoreFloat3(E0, Out + 22 * 3);
+        VectorStoreFloat3(E3, Out + 23 * 3);
+    }
+}
+
+/** Unit side vector of a ribbon, perpendicular to the line and the view direction. Camera right for lines pointing at the camera */
+static FVector3f GetRibbonSide(const FLineExpansionView& View, const FVector3f& Direction)
+{
+    const FVector3f Side = Direction ^ View.CameraZ;
+    const float SideLengthSquared = Side.SizeSquared();
+
+    return SideLengthSquared > UE_SMALL_NUMBER ? Side * FMath::InvSqrt(SideLengthSquared) : View.CameraX;
+}
+
+static float GetLineHalfThickness(const FLineExpansionView& View, bool bScreenSpace, const FVector3f& Position, float Thickness)
+{
+    const float W = View.ClipW.X * Position.X + View.ClipW.Y * Position.Y + View.ClipW.Z * Position.Z + View.ClipW.W;
+    const float Scaling = bScreenSpace ? W / View.ViewportSizeX : 1.0f;
+    const float OrthoZoomFactor = bScreenSpace ? View.OrthoZoomFactor : 1.0f;
+    const float ScreenSpaceScaling = bScreenSpace ? 2.0f : 1.0f;
+
+    return Thickness * ScreenSpaceScaling * OrthoZoomFactor * Scaling * 0.5f;
+}
+
+/**
+ * Unit offset of the strip vertex on side Sign of a line at a joint, same as in LineVertexFactory.ush.
+ * Away points from the joint to the far end of the neighbor line. Past the miter limit the outer side
+ * keeps the offset of its own line and the join quad fills the bevel, the inner side stays on the clamped miter.
+ */
+static FVector3f GetStripJointOffset(const FVector3f& Side, const FVector3f& NeighborSide, const FVector3f& Away, float Sign)
+{
+    const FVector3f OwnOffset = Side * Sign;
+
+    FVector3f Miter = Side + NeighborSide;
+    const float MiterLengthSquared = Miter.SizeSquared();
+
+    // Line folds back onto itself
+    if (MiterLengthSquared < UE_KINDA_SMALL_NUMBER)
+    {
+        return OwnOffset;
+    }
+
+    Miter *= FMath::InvSqrt(MiterLengthSquared);
+
+    const float MiterScale = 1.0f / FMath::Max(Miter | Side, UE_KINDA_SMALL_NUMBER);
+
+    if (MiterScale <= LineMiterLimit)
+    {
+        return Miter * (MiterScale * Sign);
+    }
+
+    const bool bInnerSide = (Away | OwnOffset) > 0.0f;
+
+    return bInnerSide ? Miter * (LineMiterLimit * Sign) : OwnOffset;
+}
+
+/** Offset of the strip vertex on side Sign at the start or end of a line, joined or not */
+static FVector3f GetStripVertexOffset(const FLineExpansionView& View, TConstArrayView<FPackedLine> Lines, int32 LineIndex, bool bAtEnd, const FVector3f& Side, float Sign)
+{
+    const bool bJoined = bAtEnd ? (LineIndex + 1 < Lines.Num() && IsJoinedToPreviousLine(Lines, LineIndex + 1)) : IsJoinedToPreviousLine(Lines, LineIndex);
+
+    if (!bJoined)
+    {
+        return Side * Sign;
+    }
+
+    const FPackedLine& Neighbor = Lines[bAtEnd ? LineIndex + 1 : LineIndex - 1];
+    const FVector3f NeighborStart(Neighbor.StartAndThickness);
+    const FVector3f NeighborEnd(Neighbor.End);
+
+    const FVector3f NeighborSide = GetRibbonSide(View, NeighborEnd - NeighborStart);
+    const FVector3f Away = bAtEnd ? NeighborEnd - NeighborStart : NeighborStart - NeighborEnd;
+
+    return GetStripJointOffset(Side, NeighborSide, Away, Sign);
+}
+
+/** Strip vertices: ribbon layout with ends moved onto the joints shared with neighbor lines */
+static void ExpandStripVerticesRange(const FLineExpansionView& View, bool bScreenSpace, TConstArrayView<FPackedLine> Lines, int32 FirstLine, int32 NumLines, FVector3f* OutVertices)
+{
+    for (int32 LineIndex = FirstLine; LineIndex < FirstLine + NumLines; ++LineIndex)
+    {
+        const FPackedLine& Line = Lines[LineIndex];
+
+        const FVector3f Start(Line.StartAndThickness);
+        const FVector3f End(Line.End);
+        const FVector3f Side = GetRibbonSide(View, End - Start);
+
+        const float HalfStart = GetLineHalfThickness(View, bScreenSpace, Start, Line.StartAndThickness.W);
+        const float HalfEnd = GetLineHalfThickness(View, bScreenSpace, End, Line.StartAndThickness.W);
+
+        FVector3f* Out = OutVertices + (LineIndex - FirstLine) * NumVerticesPerRibbonLine;
+
+        Out[0] = Start + GetStripVertexOffset(View, Lines, LineIndex, false, Side, 1.0f) * HalfStart;
+        Out[1] = Start + GetStripVertexOffset(View, Lines, LineIndex, false, Side, -1.0f) * HalfStart;
+        Out[2] = End + GetStripVertexOffset(View, Lines, LineIndex, true, Side, 1.0f) * HalfEnd;
+        Out[3] = End + GetStripVertexOffset(View, Lines, LineIndex, true, Side, -1.0f) * HalfEnd;
+    }
+}
+
+void BuildStripIndices(TConstArrayView<FPackedLine> Lines, uint32 BaseVertex, TArray<uint32>& OutIndices)
+{
+    OutIndices.Reserve(OutIndices.Num() + Lines.Num() * NumIndicesPerStripLine);
+
+    for (int32 LineIndex = 0; LineIndex < Lines.Num(); ++LineIndex)
+    {
+        const uint32 LineVertex = BaseVertex + LineIndex * NumVerticesPerRibbonLine;
+
+        for (int32 Index = 0; Index < NumIndicesPerRibbonLine; ++Index)
+        {
+            OutIndices.Add(LineVertex + RibbonCornerTable[Index]);
+        }
+
+        // Join quad from the end of the previous line to the start of this one, degenerate where mitered
+        if (IsJoinedToPreviousLine(Lines, LineIndex))
+        {
+            const uint32 JoinVertices[4] = { LineVertex - 2, LineVertex - 1, LineVertex + 0, LineVertex + 1 };
+
+            for (int32 Index = 0; Index < NumIndicesPerRibbonLine; ++Index)
+            {
+                OutIndices.Add(JoinVertices[RibbonCornerTable[Index]]);
+            }
+        }
+    }
+}
+
+void BuildJoinedStripIndices(int32 NumLines, uint32 BaseVertex, TArray<uint32>& OutIndices)
+{
+    OutIndices.Reserve(OutIndices.Num() + GetNumJoinedStripIndices(NumLines));
+
+    for (int32 LineIndex = 0; LineIndex < NumLines; ++LineIndex)
+    {
+        const uint32 LineVertex = BaseVertex + LineIndex * NumVerticesPerRibbonLine;
+
+        for (int32 Index = 0; Index < NumIndicesPerRibbonLine; ++Index)
+        {
+            OutIndices.Add(LineVertex + RibbonCornerTable[Index]);
+        }
+
+        if (LineIndex > 0)
+        {
+            const uint32 JoinVertices[4] = { LineVertex - 2, LineVertex - 1, LineVertex + 0, LineVertex + 1 };
+
+            for (int32 Index = 0; Index < NumIndicesPerRibbonLine; ++Index)
+            {
+                OutIndices.Add(JoinVertices[RibbonCornerTable[Index]]);
+            }
+        }
+    }
+}
+
+/** Ribbon vertices: start and end point, each offset to both sides of the line perpendicular to the view direction */
+static void ExpandRibbonVerticesRange(const FLineExpansionView& View, bool bScreenSpace, const FPackedLine* Lines, int32 NumLines, FVector3f* OutVertices)
+{
+    const VectorRegister4Float CameraX = VectorLoadFloat3_W0(&View.CameraX.X);
+    const VectorRegister4Float CameraZ = VectorLoadFloat3_W0(&View.CameraZ.X);
+
+    const float CurrentOrthoZoomFactor = bScreenSpace ? View.OrthoZoomFactor : 1.0f;
+    const float ScreenSpaceScaling = bScreenSpace ? 2.0f : 1.0f;
+
+    for (int32 LineIndex = 0; LineIndex < NumLines; ++LineIndex)
+    {
+        const FPackedLine& Line = Lines[LineIndex];
+        const float Thickness = Line.StartAndThickness.W;
+
+        const float StartW = View.ClipW.X * Line.StartAndThickness.X + View.ClipW.Y * Line.StartAndThickness.Y + View.ClipW.Z * Line.StartAndThickness.Z + View.ClipW.W;
+        const float EndW = View.ClipW.X * Line.End.X + View.ClipW.Y * Line.End.Y + View.ClipW.Z * Line.End.Z + View.ClipW.W;
+
+        const float ScalingStart = bScreenSpace ? StartW / View.ViewportSizeX : 1.0f;
+        const float ScalingEnd = bScreenSpace ? EndW / View.ViewportSizeX : 1.0f;
+
+        const float StartThickness = Thickness * ScreenSpaceScaling * CurrentOrthoZoomFactor * ScalingStart;
+        const float EndThickness = Thickness * ScreenSpaceScaling * CurrentOrthoZoomFactor * ScalingEnd;
+
+        const VectorRegister4Float Start = VectorLoadFloat3_W0(&Line.StartAndThickness.X);
+        const VectorRegister4Float End = VectorLoadFloat3_W0(&Line.End.X);
+
+        // Lines pointing at the camera have no screen extent, fall back to the camera right axis
+        VectorRegister4Float Side = VectorCross(VectorSubtract(End, Start), CameraZ);
+        const float SideLengthSquared = VectorDot3Scalar(Side, Side);
+        Side = SideLengthSquared > UE_SMALL_NUMBER ? VectorMultiply(Side, VectorSetFloat1(FMath::InvSqrt(SideLengthSquared))) : CameraX;
+
+        const VectorRegister4Float SideStart = VectorMultiply(Side, VectorSetFloat1(StartThickness * 0.5f));
+        const VectorRegister4Float SideEnd = VectorMultiply(Side, VectorSetFloat1(EndThickness * 0.5f));
+
+        float* Out = &OutVertices[LineIndex * NumVerticesPerRibbonLine].X;
+
+        VectorStoreFloat3(VectorAdd(Start, SideStart), Out + 0 * 3);
+        VectorStoreFloat3(VectorSubtract(Start, SideStart), Out + 1 * 3);
+        VectorStoreFloat3(VectorAdd(End, SideEnd), Out + 2 * 3);
+        VectorStoreFloat3(VectorSubtract(End, SideEnd), Out + 3 * 3);
+    }
+}
+
+void BuildStaticLineVertices(TConstArrayView<FPackedLine> Lines, FVector3f* OutVertices)
+{
+    for (int32 LineIndex = 0; LineIndex < Lines.Num(); ++LineIndex)
+    {
+        const FPackedLine& Line = Lines[LineIndex];
+        const FVector3f Start(Line.StartAndThickness);
+        const FVector3f End(Line.End);
+        const float HalfThickness = Line.StartAndThickness.W * 0.5f;
+
+        // Any two axes perpendicular to the line, the tube looks the same from every side
+        const FVector3f Direction = (End - Start).GetSafeNormal(UE_SMALL_NUMBER, FVector3f::ForwardVector);
+        const FVector3f ReferenceAxis = FMath::Abs(Direction.Z) < 0.99f ? FVector3f::UpVector : FVector3f::ForwardVector;
+        const FVector3f AxisA = (Direction ^ ReferenceAxis).GetUnsafeNormal();
+        const FVector3f AxisB = Direction ^ AxisA;
+
+        const FVector3f FaceNormals[NumFacesPerStaticLine] = { AxisA, AxisB, -AxisA, -AxisB };
+
+        FVector3f* Out = OutVertices + LineIndex * NumVerticesPerStaticLine;
+
+        for (const FVector3f& FaceNormal : FaceNormals)
+        {
+            // Corners of a ribbon seen from outside the face, whose side axis is FaceNormal ^ Direction
+            const FVector3f FaceOffset = FaceNormal * HalfThickness;
+            const FVector3f SideOffset = (FaceNormal ^ Direction) * HalfThickness;
+
+            Out[0] = Start + FaceOffset + SideOffset;
+            Out[1] = Start + FaceOffset - SideOffset;
+            Out[2] = End + FaceOffset + SideOffset;
+            Out[3] = End + FaceOffset - SideOffset;
+
+            Out += NumVerticesPerRibbonLine;
+        }
+    }
+}
+
+void ExpandLineVertices(const FLineExpansionView& View, bool bScreenSpace, ELineGeometryMode Mode, TConstArrayView<FPackedLine> Lines, FVector3f* OutVertices)
+{
+    const int32 NumLines = Lines.Num();
+    const int32 BatchSize = CVarLineRendererParallelExpansionBatchSize.GetValueOnAnyThread();
+    const int32 VerticesPerLine = GetNumVerticesPerLine(Mode);
+
+    auto ExpandRange = [&View, bScreenSpace, Mode, &Lines](int32 FirstLine, int32 NumRangeLines, FVector3f* OutRangeVertices)
+    {
+        switch (Mode)
+        {
+        case ELineGeometryMode::Ribbon:
+            ExpandRibbonVerticesRange(View, bScreenSpace, Lines.GetData() + FirstLine, NumRangeLines, OutRangeVertices);
+            break;
+        case ELineGeometryMode::Strip:
+            // Joints read the neighbor lines, which may belong to another range
+            ExpandStripVerticesRange(View, bScreenSpace, Lines, FirstLine, NumRangeLines, OutRangeVertices);
+            break;
+        default:
+            ExpandLineVerticesRange(View, bScreenSpace, Lines.GetData() + FirstLine, NumRangeLines, OutRangeVertices);
+            break;
+        }
+    };
+
+    if (BatchSize <= 0 || NumLines <= BatchSize)
+    {
+        ExpandRange(0, NumLines, OutVertices);
+        return;
+    }
+
+    const int32 NumBatches = FMath::DivideAndRoundUp(NumLines, BatchSize);
+
+    ParallelFor(NumBatches, [OutVertices, NumLines, BatchSize, VerticesPerLine, &ExpandRange](int32 BatchIndex)
+    {
+        const int32 FirstLine = BatchIndex * BatchSize;
+        const int32 NumBatchLines = FMath::Min(BatchSize, NumLines - FirstLine);
+
+        ExpandRange(FirstLine, NumBatchLines, OutVertices + FirstLine * VerticesPerLine);
+    });
+}
+
+FVector3f ExpandLineVertexFromId(const FLineExpansionView& View, bool bScreenSpace, ELineGeometryMode Mode, TConstArrayView<FPackedLine> Lines, uint32 VertexId)
+{
+    // Instance and vertex id of the instanced GPU draw
+    const uint32 IndicesPerLine = GetNumIndicesPerLine(Mode);
+    const uint32 LineIndex = VertexId / IndicesPerLine;
+    const uint32 LineVertex = VertexId % IndicesPerLine;
+
+    const FPackedLine& Line = Lines[LineIndex];
+
+    if (Mode == ELineGeometryMode::Strip)
+    {
+        // First six vertices are the ribbon quad, the last six the join quad from the previous line end to this line start
+        const bool bJoinQuad = LineVertex >= NumIndicesPerRibbonLine;
+        const uint32 Corner = RibbonCornerTable[LineVertex % NumIndicesPerRibbonLine];
+
+        if (bJoinQuad && !IsJoinedToPreviousLine(Lines, LineIndex))
+        {
+            return FVector3f(Line.StartAndThickness);
+        }
+
+        const int32 VertexLineIndex = (bJoinQuad && !(Corner & 2)) ? LineIndex - 1 : LineIndex;
+        const bool bAtEnd = bJoinQuad ? !(Corner & 2) : (Corner & 2) != 0;
+
+        const FPackedLine& VertexLine = Lines[VertexLineIndex];
+        const FVector3f Start(VertexLine.StartAndThickness);
+        const FVector3f End(VertexLine.End);
+        const FVector3f Position = bAtEnd ? End : Start;
+
+        const float Sign = (Corner & 1) ? -1.0f : 1.0f;
+        const FVector3f Offset = GetStripVertexOffset(View, Lines, VertexLineIndex, bAtEnd, GetRibbonSide(View, End - Start), Sign);
+
+        return Position + Offset * GetLineHalfThickness(View, bScreenSpace, Position, VertexLine.StartAndThickness.W);
+    }
+
+    if (Mode == ELineGeometryMode::Ribbon)
+    {
+        const uint32 Corner = RibbonCornerTable[LineVertex];
+        const FVector3f Position = (Corner & 2) ? FVector3f(Line.End) : FVector3f(Line.StartAndThickness);
+
+        const FVector3f Side = GetRibbonSide(View, FVector3f(Line.End) - FVector3f(Line.StartAndThickness));
+        const float Sign = (Corner & 1) ? -1.0f : 1.0f;
+
+        return Position + Side * (Sign * GetLineHalfThickness(View, bScreenSpace, Position, Line.StartAndThickness.W));
+    }
+
+    const uint32 Corner = LineCornerTable[LineVertex];
+    const FVector3f Position = (Corner & 4) ? FVector3f(Line.End) : FVector3f(Line.StartAndThickness);
+
+    const uint32 CornerIndex = Corner & 3;
+    const float SignX = CornerIndex < 2 ? 1.0f : -1.0f;
+    const float SignY = (CornerIndex & 1) ? 1.0f : -1.0f;
+
+    return Position + (View.CameraX * SignX + View.CameraY * SignY) * GetLineHalfThickness(View, bScreenSpace, Position, Line.StartAndThickness.W);
+}
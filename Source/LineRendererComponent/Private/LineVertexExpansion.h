@@ -0,0 +1,99 @@
+// Copyright 2023 Petr Leontev. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "LineSectionInfo.h"
+#include "LinePackedLine.h"
+
+/* Camera facing expansion of line segments into triangles */
+
+static_assert((uint32)ELineGeometryMode::Caps == LineGeometryModeCaps && (uint32)ELineGeometryMode::Ribbon == LineGeometryModeRibbon && (uint32)ELineGeometryMode::Strip == LineGeometryModeStrip,
+    "LinePackedLine.h mirrors ELineGeometryMode for the shader module");
+
+/** Faces of the square tube a static line is built from, each one laid out as a ribbon quad */
+static constexpr int32 NumFacesPerStaticLine = 4;
+static constexpr int32 NumVerticesPerStaticLine = NumFacesPerStaticLine * NumVerticesPerRibbonLine;
+
+/** Vertices written by the expansion kernel per line */
+inline int32 GetNumVerticesPerLine(ELineGeometryMode Mode)
+{
+    return Mode == ELineGeometryMode::Caps ? NumVerticesPerLine : NumVerticesPerRibbonLine;
+}
+
+/** Indices per line, also the number of vertices per instance of GPU expansion. Upper bound for strips */
+inline int32 GetNumIndicesPerLine(ELineGeometryMode Mode)
+{
+    switch (Mode)
+    {
+    case ELineGeometryMode::Ribbon:
+        return NumIndicesPerRibbonLine;
+    case ELineGeometryMode::Strip:
+        return NumIndicesPerStripLine;
+    default:
+        return NumVerticesPerLine;
+    }
+}
+
+/** Whether a line starts where the previous one ends, strips join such lines */
+inline bool IsJoinedToPreviousLine(TConstArrayView<FPackedLine> Lines, int32 LineIndex)
+{
+    return LineIndex > 0 && FVector3f(Lines[LineIndex - 1].End) == FVector3f(Lines[LineIndex].StartAndThickness);
+}
+
+/**
+ * Appends strip indices of Lines whose vertices start at BaseVertex: a ribbon quad per line
+ * and a join quad towards the previous line where the two are joined. Depends on the lines only, not on the view.
+ */
+void BuildStripIndices(TConstArrayView<FPackedLine> Lines, uint32 BaseVertex, TArray<uint32>& OutIndices);
+
+/** Same indices as BuildStripIndices for a single run of NumLines joined lines, lets streaming sections reserve indices ahead of their lines */
+void BuildJoinedStripIndices(int32 NumLines, uint32 BaseVertex, TArray<uint32>& OutIndices);
+
+/** Number of indices BuildJoinedStripIndices writes for NumLines lines, the first line has no join quad */
+inline int32 GetNumJoinedStripIndices(int32 NumLines)
+{
+    return NumLines > 0 ? NumLines * NumIndicesPerStripLine - NumIndicesPerRibbonLine : 0;
+}
+
+/** View dependent inputs of the expansion, computed once per view */
+struct FLineExpansionView
+{
+    FLineExpansionView(const FMatrix& WorldToClip, const FMatrix& ClipToWorld, const FMatrix& ProjectionMatrix, uint32 InViewportSizeX);
+
+    /** Basis halfway between the two eyes of a stereo pair, lines expanded with it are drawn by both eyes */
+    static FLineExpansionView GetStereoMidpoint(const FLineExpansionView& Left, const FLineExpansionView& Right);
+
+    /** Camera right, up and forward axes */
+    FVector3f CameraX;
+    FVector3f CameraY;
+    FVector3f CameraZ;
+    /** Last column of the world to clip matrix, produces clip space W */
+    FVector4 ClipW;
+    /** Viewport width in pixels */
+    float ViewportSizeX;
+    /** Thickness scale of orthographic views */
+    float OrthoZoomFactor;
+};
+
+/**
+ * Expands lines into GetNumVerticesPerLine(Mode) positions each and writes them to OutVertices.
+ * Large inputs are split across ParallelFor workers writing disjoint ranges of OutVertices.
+ *
+ * Output matches the former scalar double precision loop within float rounding:
+ * each component differs by at most a few ulps of the larger of the endpoint coordinate and the half thickness.
+ */
+void ExpandLineVertices(const FLineExpansionView& View, bool bScreenSpace, ELineGeometryMode Mode, TConstArrayView<FPackedLine> Lines, FVector3f* OutVertices);
+
+/**
+ * Builds a square tube around each line, NumFacesPerStaticLine ribbon quads facing away from the line.
+ * Independent of the view, static sections build it once and draw it with the ribbon topology.
+ */
+void BuildStaticLineVertices(TConstArrayView<FPackedLine> Lines, FVector3f* OutVertices);
+
+/**
+ * Computes one expanded vertex from its vertex id the same way LineVertexFactory.ush does on the GPU.
+ * CPU reference of the shader math, matches ExpandLineVertices for components with identity transform.
+ * Vertex ids count GetNumIndicesPerLine(Mode) per line, the shader draws one instance per line from the same pattern.
+ */
+FVector3f ExpandLineVertexFromId(const FLineExpansionView& View, bool bScreenSpace, ELineGeometryMode Mode, TConstArrayView<FPackedLine> Lines, uint32 VertexId);
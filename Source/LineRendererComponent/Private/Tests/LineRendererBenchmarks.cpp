@@ -0,0 +1,521 @@
+// Copyright 2023 Petr Leontev. All Rights Reserved.
+
+#include "CoreMinimal.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "Engine/Engine.h"
+#include "Engine/World.h"
+#include "HAL/FileManager.h"
+#include "HAL/PlatformTime.h"
+#include "Materials/Material.h"
+#include "Math/RandomStream.h"
+#include "Misc/DateTime.h"
+#include "Misc/EngineVersion.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "RenderingThread.h"
+#include "UObject/Package.h"
+#include "UObject/UnrealType.h"
+#include "LineRendererComponent.h"
+#include "LineTopologyBuffers.h"
+#include "LineVertexExpansion.h"
+
+/*
+ * Benchmarks of line creation, expansion and bounds, runnable headless:
+ * UnrealEditor-Cmd <Project> -nullrhi -unattended -ExecCmds="Automation RunTests LineRenderer.Benchmark; Quit"
+ * Every measurement is logged as a "LineRendererBenchmark," row and appended to Saved/Automation/LineRenderer/Benchmarks.csv.
+ */
+
+namespace LineRendererBenchmarks
+{
+    /** Minimum time spent repeating a measurement, short workloads are repeated to get above timer noise */
+    static constexpr double MinMeasureSeconds = 0.25;
+    static constexpr int32 MinMeasureFrames = 3;
+    static constexpr int32 MaxMeasureFrames = 1000;
+
+    /** Expansion is measured in chunks of this many lines so that a million lines do not need hundreds of megabytes of vertices */
+    static constexpr int32 ExpansionChunkLines = 64 * 1024;
+
+    struct FWorkload
+    {
+        int32 NumSegments = 1;
+        int32 NumSections = 1;
+        bool bScreenSpace = false;
+
+        int32 GetSegmentsPerSection() const
+        {
+            return FMath::Max(NumSegments / NumSections, 1);
+        }
+
+        int32 GetTotalSegments() const
+        {
+            return GetSegmentsPerSection() * NumSections;
+        }
+
+        FString ToString() const
+        {
+            return FString::Printf(TEXT("Segments=%d Sections=%d ScreenSpace=%d"), NumSegments, NumSections, bScreenSpace ? 1 : 0);
+        }
+
+        static FWorkload Parse(const FString& Parameters)
+        {
+            FWorkload Workload;
+            int32 ScreenSpace = 0;
+
+            FParse::Value(*Parameters, TEXT("Segments="), Workload.NumSegments);
+            FParse::Value(*Parameters, TEXT("Sections="), Workload.NumSections);
+            FParse::Value(*Parameters, TEXT("ScreenSpace="), ScreenSpace);
+
+            Workload.NumSegments = FMath::Max(Workload.NumSegments, 1);
+            Workload.NumSections = FMath::Clamp(Workload.NumSections, 1, Workload.NumSegments);
+            Workload.bScreenSpace = ScreenSpace != 0;
+
+            return Workload;
+        }
+    };
+
+    /** 1 to 1M segments over 1 to 10k sections, in world and screen space */
+    static void GetWorkloads(TArray<FString>& OutBeautifiedNames, TArray<FString>& OutTestCommands)
+    {
+        static const int32 SegmentCounts[] = { 1, 1000, 100000, 1000000 };
+        static const int32 SectionCounts[] = { 1, 100, 10000 };
+
+        for (int32 NumSegments : SegmentCounts)
+        {
+            for (int32 NumSections : SectionCounts)
+            {
+                if (NumSections > NumSegments)
+                {
+                    continue;
+                }
+
+                for (bool bScreenSpace : { false, true })
+                {
+                    FWorkload Workload;
+                    Workload.NumSegments = NumSegments;
+                    Workload.NumSections = NumSections;
+                    Workload.bScreenSpace = bScreenSpace;
+
+                    OutBeautifiedNames.Add(FString::Printf(TEXT("%d Segments %d Sections %s"), NumSegments, NumSections, bScreenSpace ? TEXT("ScreenSpace") : TEXT("WorldSpace")));
+                    OutTestCommands.Add(Workload.ToString());
+                }
+            }
+        }
+    }
+
+    /** Random walk polylines, one per section. Seeded so that every build measures the same lines */
+    static TArray<FLineSectionDescription> MakeLineDescriptions(const FWorkload& Workload)
+    {
+        FRandomStream Random(0x4c696e65);
+
+        const int32 SegmentsPerSection = Workload.GetSegmentsPerSection();
+
+        TArray<FLineSectionDescription> Descriptions;
+        Descriptions.SetNum(Workload.NumSections);
+
+        for (int32 SectionIndex = 0; SectionIndex < Workload.NumSections; ++SectionIndex)
+        {
+            FLineSectionDescription& Description = Descriptions[SectionIndex];
+            Description.SectionIndex = SectionIndex;
+            Description.Color = FLinearColor(Random.FRand(), Random.FRand(), Random.FRand());
+            Description.Thickness = Workload.bScreenSpace ? 2.0f : 5.0f;
+            Description.bScreenSpace = Workload.bScreenSpace;
+
+            FVector Point(Random.FRandRange(-5000.0f, 5000.0f), Random.FRandRange(-5000.0f, 5000.0f), Random.FRandRange(0.0f, 1000.0f));
+
+            Description.Vertices.Reserve(SegmentsPerSection + 1);
+            Description.Vertices.Add(Point);
+
+            for (int32 SegmentIndex = 0; SegmentIndex < SegmentsPerSection; ++SegmentIndex)
+            {
+                Point += Random.GetUnitVector() * Random.FRandRange(10.0f, 100.0f);
+                Description.Vertices.Add(Point);
+            }
+        }
+
+        return Descriptions;
+    }
+
+    /** Same lines as the proxy packs them for expansion */
+    static TArray<FPackedLine> PackLineDescriptions(TConstArrayView<FLineSectionDescription> Descriptions)
+    {
+        TArray<FPackedLine> Lines;
+
+        for (const FLineSectionDescription& Description : Descriptions)
+        {
+            const FColor Color = Description.Color.ToFColor(true);
+
+            for (int32 PointIndex = 0; PointIndex + 1 < Description.Vertices.Num(); ++PointIndex)
+            {
+                FPackedLine& Line = Lines.AddDefaulted_GetRef();
+                Line.StartAndThickness = FVector4f(FVector3f(Description.Vertices[PointIndex]), Description.Thickness);
+                Line.End = FVector4f(FVector3f(Description.Vertices[PointIndex + 1]), 0.0f);
+                SetPackedLineColor(Line, Color);
+            }
+        }
+
+        return Lines;
+    }
+
+    static FLineExpansionView MakeExpansionView(const FVector& EyeLocation)
+    {
+        const FMatrix ViewMatrix = FLookAtMatrix(EyeLocation, FVector(0.0f, 0.0f, 500.0f), FVector::UpVector);
+        const FMatrix ProjectionMatrix = FReversedZPerspectiveMatrix(HALF_PI * 0.5f, 1920.0f, 1080.0f, 10.0f);
+        const FMatrix WorldToClip = ViewMatrix * ProjectionMatrix;
+
+        return FLineExpansionView(WorldToClip, WorldToClip.Inverse(), ProjectionMatrix, 1920);
+    }
+
+    /** Repeats Frame until enough time is measured, returns seconds per frame */
+    static double MeasureSecondsPerFrame(TFunctionRef<void()> Frame)
+    {
+        int32 NumFrames = 0;
+        const double StartTime = FPlatformTime::Seconds();
+        double Elapsed = 0.0;
+
+        do
+        {
+            Frame();
+            ++NumFrames;
+            Elapsed = FPlatformTime::Seconds() - StartTime;
+        }
+        while (NumFrames < MaxMeasureFrames && (NumFrames < MinMeasureFrames || Elapsed < MinMeasureSeconds));
+
+        return Elapsed / NumFrames;
+    }
+
+    /** Logs a measurement as a CSV row and appends it to Saved/Automation/LineRenderer/Benchmarks.csv */
+    static void ReportMetric(FAutomationTestBase& Test, const TCHAR* Benchmark, const FWorkload& Workload, const TCHAR* Metric, double Value)
+    {
+        const FString Row = FString::Printf(TEXT("%s,%s,%s,%d,%d,%d,%s,%.6f"),
+            *FDateTime::UtcNow().ToIso8601(),
+            *FEngineVersion::Current().ToString(),
+            Benchmark,
+            Workload.GetTotalSegments(),
+            Workload.NumSections,
+            Workload.bScreenSpace ? 1 : 0,
+            Metric,
+            Value);
+
+        Test.AddInfo(FString::Printf(TEXT("LineRendererBenchmark,%s"), *Row));
+
+        const FString CsvPath = FPaths::Combine(FPaths::AutomationDir(), TEXT("LineRenderer"), TEXT("Benchmarks.csv"));
+        if (!IFileManager::Get().FileExists(*CsvPath))
+        {
+            FFileHelper::SaveStringToFile(TEXT("Timestamp,EngineVersion,Benchmark,Segments,Sections,ScreenSpace,Metric,Value\n"), *CsvPath);
+        }
+
+        FFileHelper::SaveStringToFile(Row + TEXT("\n"), *CsvPath, FFileHelper::EEncodingOptions::AutoDetect, &IFileManager::Get(), FILEWRITE_Append);
+    }
+
+    static void ReportMemory(FAutomationTestBase& Test, const TCHAR* Benchmark, const FWorkload& Workload, const ULineRendererComponent& Component)
+    {
+        const FLineSectionMemoryStats Memory = Component.GetLineMemoryStats();
+
+        ReportMetric(Test, Benchmark, Workload, TEXT("CPUBytes"), Memory.LineBytes);
+        ReportMetric(Test, Benchmark, Workload, TEXT("GPUBytes"), Memory.GetGPUBytes());
+        ReportMetric(Test, Benchmark, Workload, TEXT("SharedTopologyBytes"), FLineTopologyBuffers::GetTotalAllocatedBytes());
+    }
+
+    static ULineRendererComponent* CreateComponent()
+    {
+        ULineRendererComponent* Component = NewObject<ULineRendererComponent>(GetTransientPackage(), NAME_None, RF_Transient);
+
+        // LineMaterial is editor facing only, per section material instances are created from the default surface material as in a real level
+        if (FObjectProperty* MaterialProperty = FindFProperty<FObjectProperty>(ULineRendererComponent::StaticClass(), TEXT("LineMaterial")))
+        {
+            MaterialProperty->SetObjectPropertyValue_InContainer(Component, UMaterial::GetDefaultMaterial(MD_Surface));
+        }
+
+        return Component;
+    }
+
+    /** Game world with a scene, so that registered components get a scene proxy. NullRHI is enough */
+    class FBenchmarkWorld
+    {
+    public:
+        FBenchmarkWorld()
+        {
+            World = UWorld::CreateWorld(EWorldType::Game, false, TEXT("LineRendererBenchmark"));
+
+            FWorldContext& WorldContext = GEngine->CreateNewWorldContext(EWorldType::Game);
+            WorldContext.SetCurrentWorld(World);
+        }
+
+        ~FBenchmarkWorld()
+        {
+            FlushRenderingCommands();
+
+            GEngine->DestroyWorldContext(World);
+            World->DestroyWorld(false);
+        }
+
+        bool HasScene() const
+        {
+            return World != nullptr && World->Scene != nullptr;
+        }
+
+        /** Registers the component and creates its scene proxy right away instead of at the end of the frame */
+        void Register(ULineRendererComponent& Component)
+        {
+            Component.RegisterComponentWithWorld(World);
+            Component.MarkRenderStateDirty();
+            World->SendAllEndOfFrameUpdates();
+
+            FlushRenderingCommands();
+        }
+
+        void Unregister(ULineRendererComponent& Component)
+        {
+            Component.UnregisterComponent();
+
+            FlushRenderingCommands();
+        }
+
+    private:
+        UWorld* World = nullptr;
+    };
+}
+
+using namespace LineRendererBenchmarks;
+
+IMPLEMENT_COMPLEX_AUTOMATION_TEST(FLineRendererCreateBenchmark, "LineRenderer.Benchmark.Create", EAutomationTestFlags::EditorContext | EAutomationTestFlags::ClientContext | EAutomationTestFlags::PerfFilter)
+
+void FLineRendererCreateBenchmark::GetTests(TArray<FString>& OutBeautifiedNames, TArray<FString>& OutTestCommands) const
+{
+    GetWorkloads(OutBeautifiedNames, OutTestCommands);
+}
+
+bool FLineRendererCreateBenchmark::RunTest(const FString& Parameters)
+{
+    const FWorkload Workload = FWorkload::Parse(Parameters);
+    const TArray<FLineSectionDescription> Descriptions = MakeLineDescriptions(Workload);
+    const double NumLines = Workload.GetTotalSegments();
+
+    FBenchmarkWorld BenchmarkWorld;
+    ULineRendererComponent* Component = CreateComponent();
+
+    // Game thread storage only, no proxy yet
+    double StartTime = FPlatformTime::Seconds();
+    Component->CreateLines(Descriptions);
+    const double StoreSeconds = FPlatformTime::Seconds() - StartTime;
+
+    ReportMetric(*this, TEXT("CreateLines"), Workload, TEXT("GameThreadMs"), StoreSeconds * 1000.0);
+    ReportMetric(*this, TEXT("CreateLines"), Workload, TEXT("LinesPerSecond"), NumLines / FMath::Max(StoreSeconds, UE_SMALL_NUMBER));
+
+    TestEqual(TEXT("Sections stored"), Component->GetNumSections(), Workload.NumSections);
+
+    if (!BenchmarkWorld.HasScene())
+    {
+        AddInfo(TEXT("World has no scene, proxy benchmarks skipped"));
+        return true;
+    }
+
+    // Proxy creation, AddNewSections_GameThread and the render thread initialization of every section
+    StartTime = FPlatformTime::Seconds();
+    BenchmarkWorld.Register(*Component);
+    const double ProxySeconds = FPlatformTime::Seconds() - StartTime;
+
+    ReportMetric(*this, TEXT("CreateProxy"), Workload, TEXT("Ms"), ProxySeconds * 1000.0);
+    ReportMetric(*this, TEXT("CreateProxy"), Workload, TEXT("LinesPerSecond"), NumLines / FMath::Max(ProxySeconds, UE_SMALL_NUMBER));
+    ReportMemory(*this, TEXT("CreateProxy"), Workload, *Component);
+
+    // Replacing every section of a live proxy, game thread cost and the render command separately
+    StartTime = FPlatformTime::Seconds();
+    Component->UpdateLines(Descriptions);
+    const double UpdateSeconds = FPlatformTime::Seconds() - StartTime;
+    FlushRenderingCommands();
+    const double UpdateFlushedSeconds = FPlatformTime::Seconds() - StartTime;
+
+    ReportMetric(*this, TEXT("UpdateLines"), Workload, TEXT("GameThreadMs"), UpdateSeconds * 1000.0);
+    ReportMetric(*this, TEXT("UpdateLines"), Workload, TEXT("TotalMs"), UpdateFlushedSeconds * 1000.0);
+    ReportMetric(*this, TEXT("UpdateLines"), Workload, TEXT("LinesPerSecond"), NumLines / FMath::Max(UpdateFlushedSeconds, UE_SMALL_NUMBER));
+
+    TestEqual(TEXT("Sections after the update"), Component->GetNumSections(), Workload.NumSections);
+
+    BenchmarkWorld.Unregister(*Component);
+
+    return true;
+}
+
+IMPLEMENT_COMPLEX_AUTOMATION_TEST(FLineRendererBulkCreateBenchmark, "LineRenderer.Benchmark.BulkCreate", EAutomationTestFlags::EditorContext | EAutomationTestFlags::ClientContext | EAutomationTestFlags::PerfFilter)
+
+void FLineRendererBulkCreateBenchmark::GetTests(TArray<FString>& OutBeautifiedNames, TArray<FString>& OutTestCommands) const
+{
+    GetWorkloads(OutBeautifiedNames, OutTestCommands);
+}
+
+bool FLineRendererBulkCreateBenchmark::RunTest(const FString& Parameters)
+{
+    const FWorkload Workload = FWorkload::Parse(Parameters);
+    const TArray<FLineSectionDescription> Descriptions = MakeLineDescriptions(Workload);
+    const double NumLines = Workload.GetTotalSegments();
+
+    FBenchmarkWorld BenchmarkWorld;
+    if (!BenchmarkWorld.HasScene())
+    {
+        AddInfo(TEXT("World has no scene, benchmark skipped"));
+        return true;
+    }
+
+    ULineRendererComponent* Component = CreateComponent();
+
+    // A placeholder line gives the component a proxy, so that both paths below send render commands
+    Component->CreateLine2Points(-1, FVector::ZeroVector, FVector::OneVector, FLinearColor::White);
+    BenchmarkWorld.Register(*Component);
+
+    // One render command per section
+    double StartTime = FPlatformTime::Seconds();
+    for (const FLineSectionDescription& Description : Descriptions)
+    {
+        Component->CreateLine(Description.SectionIndex, Description.Vertices, Description.Color, Description.Thickness, Description.bScreenSpace);
+    }
+    FlushRenderingCommands();
+    const double SingleSeconds = FPlatformTime::Seconds() - StartTime;
+
+    TestEqual(TEXT("Sections created one by one"), Component->GetNumSections(), Workload.NumSections + 1);
+
+    TArray<int32> SectionIndices;
+    for (const FLineSectionDescription& Description : Descriptions)
+    {
+        SectionIndices.Add(Description.SectionIndex);
+    }
+    Component->RemoveLines(SectionIndices);
+    FlushRenderingCommands();
+
+    // One render command for all sections
+    StartTime = FPlatformTime::Seconds();
+    Component->CreateLines(Descriptions);
+    FlushRenderingCommands();
+    const double BulkSeconds = FPlatformTime::Seconds() - StartTime;
+
+    TestEqual(TEXT("Sections created in bulk"), Component->GetNumSections(), Workload.NumSections + 1);
+
+    ReportMetric(*this, TEXT("CreateLine"), Workload, TEXT("TotalMs"), SingleSeconds * 1000.0);
+    ReportMetric(*this, TEXT("CreateLine"), Workload, TEXT("LinesPerSecond"), NumLines / FMath::Max(SingleSeconds, UE_SMALL_NUMBER));
+    ReportMetric(*this, TEXT("CreateLinesBulk"), Workload, TEXT("TotalMs"), BulkSeconds * 1000.0);
+    ReportMetric(*this, TEXT("CreateLinesBulk"), Workload, TEXT("LinesPerSecond"), NumLines / FMath::Max(BulkSeconds, UE_SMALL_NUMBER));
+    ReportMemory(*this, TEXT("CreateLinesBulk"), Workload, *Component);
+
+    BenchmarkWorld.Unregister(*Component);
+
+    return true;
+}
+
+IMPLEMENT_COMPLEX_AUTOMATION_TEST(FLineRendererExpansionBenchmark, "LineRenderer.Benchmark.Expansion", EAutomationTestFlags::EditorContext | EAutomationTestFlags::ClientContext | EAutomationTestFlags::PerfFilter)
+
+void FLineRendererExpansionBenchmark::GetTests(TArray<FString>& OutBeautifiedNames, TArray<FString>& OutTestCommands) const
+{
+    GetWorkloads(OutBeautifiedNames, OutTestCommands);
+}
+
+bool FLineRendererExpansionBenchmark::RunTest(const FString& Parameters)
+{
+    const FWorkload Workload = FWorkload::Parse(Parameters);
+    const TArray<FPackedLine> Lines = PackLineDescriptions(MakeLineDescriptions(Workload));
+    const double NumLines = Lines.Num();
+
+    // Two eyes 6.4cm apart, expanded per view as separate views are, or once from their midpoint as stereo pairs are
+    const FLineExpansionView LeftView = MakeExpansionView(FVector(-8000.0f, -3.2f, 3000.0f));
+    const FLineExpansionView RightView = MakeExpansionView(FVector(-8000.0f, 3.2f, 3000.0f));
+    const FLineExpansionView StereoView = FLineExpansionView::GetStereoMidpoint(LeftView, RightView);
+
+    struct FViewSetup
+    {
+        const TCHAR* Name;
+        TArray<const FLineExpansionView*> Views;
+    };
+
+    const FViewSetup ViewSetups[] =
+    {
+        { TEXT("OneView"), { &LeftView } },
+        { TEXT("TwoViews"), { &LeftView, &RightView } },
+        { TEXT("StereoPair"), { &StereoView } },
+    };
+
+    static const TPair<ELineGeometryMode, const TCHAR*> Modes[] =
+    {
+        { ELineGeometryMode::Caps, TEXT("Caps") },
+        { ELineGeometryMode::Ribbon, TEXT("Ribbon") },
+        { ELineGeometryMode::Strip, TEXT("Strip") },
+    };
+
+    TArray<FVector3f> Vertices;
+
+    for (const TPair<ELineGeometryMode, const TCHAR*>& Mode : Modes)
+    {
+        const int32 VerticesPerLine = GetNumVerticesPerLine(Mode.Key);
+        Vertices.SetNumUninitialized(FMath::Min(Lines.Num(), ExpansionChunkLines) * VerticesPerLine);
+
+        for (const FViewSetup& ViewSetup : ViewSetups)
+        {
+            const double SecondsPerFrame = MeasureSecondsPerFrame([&]()
+            {
+                for (const FLineExpansionView* View : ViewSetup.Views)
+                {
+                    for (int32 FirstLine = 0; FirstLine < Lines.Num(); FirstLine += ExpansionChunkLines)
+                    {
+                        const int32 NumChunkLines = FMath::Min(Lines.Num() - FirstLine, ExpansionChunkLines);
+                        ExpandLineVertices(*View, Workload.bScreenSpace, Mode.Key, TConstArrayView<FPackedLine>(Lines).Slice(FirstLine, NumChunkLines), Vertices.GetData());
+                    }
+                }
+            });
+
+            const FString Benchmark = FString::Printf(TEXT("Expand%s%s"), Mode.Value, ViewSetup.Name);
+
+            ReportMetric(*this, *Benchmark, Workload, TEXT("MsPerFrame"), SecondsPerFrame * 1000.0);
+            ReportMetric(*this, *Benchmark, Workload, TEXT("LinesPerSecond"), NumLines / FMath::Max(SecondsPerFrame, UE_SMALL_NUMBER));
+            ReportMetric(*this, *Benchmark, Workload, TEXT("VertexBytesPerView"), double(Lines.Num()) * VerticesPerLine * sizeof(FVector3f));
+        }
+
+        TestFalse(FString::Printf(TEXT("%s vertices are finite"), Mode.Value), Vertices.Num() > 0 && Vertices[0].ContainsNaN());
+    }
+
+    return true;
+}
+
+IMPLEMENT_COMPLEX_AUTOMATION_TEST(FLineRendererBoundsBenchmark, "LineRenderer.Benchmark.Bounds", EAutomationTestFlags::EditorContext | EAutomationTestFlags::ClientContext | EAutomationTestFlags::PerfFilter)
+
+void FLineRendererBoundsBenchmark::GetTests(TArray<FString>& OutBeautifiedNames, TArray<FString>& OutTestCommands) const
+{
+    GetWorkloads(OutBeautifiedNames, OutTestCommands);
+}
+
+bool FLineRendererBoundsBenchmark::RunTest(const FString& Parameters)
+{
+    const FWorkload Workload = FWorkload::Parse(Parameters);
+    const TArray<FLineSectionDescription> Descriptions = MakeLineDescriptions(Workload);
+
+    ULineRendererComponent* Component = CreateComponent();
+    Component->CreateLines(Descriptions);
+
+    USceneComponent* SceneComponent = Component;
+
+    // A moving component, every frame computes bounds for a new transform
+    FTransform LocalToWorld = FTransform::Identity;
+    FBoxSphereBounds Bounds;
+
+    const double SecondsPerFrame = MeasureSecondsPerFrame([&]()
+    {
+        LocalToWorld.AddToTranslation(FVector(1.0f, 0.0f, 0.0f));
+        Bounds = SceneComponent->CalcBounds(LocalToWorld);
+    });
+
+    ReportMetric(*this, TEXT("CalcBounds"), Workload, TEXT("MsPerFrame"), SecondsPerFrame * 1000.0);
+    ReportMemory(*this, TEXT("CalcBounds"), Workload, *Component);
+
+    const FBox Box = SceneComponent->CalcBounds(FTransform::Identity).GetBox();
+    for (const FLineSectionDescription& Description : Descriptions)
+    {
+        if (!TestTrue(TEXT("Bounds contain the first point of every line"), Box.IsInsideOrOn(Description.Vertices[0])))
+        {
+            break;
+        }
+    }
+
+    return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
@@ -0,0 +1,206 @@
+// Copyright 2023 Petr Leontev. All Rights Reserved.
+
+#include "CoreMinimal.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "Math/RandomStream.h"
+#include "UObject/Package.h"
+#include "LineRendererComponent.h"
+#include "LineSectionSlotMap.h"
+#include "LineSimplification.h"
+
+/*
+ * Correctness tests of section storage and simplification, run with:
+ * UnrealEditor-Cmd <Project> -nullrhi -unattended -ExecCmds="Automation RunTests LineRenderer.Sections+LineRenderer.LOD; Quit"
+ */
+
+namespace LineRendererTests
+{
+    /** Distances of the simplification are compared within this, lines span a few thousand units */
+    static constexpr float DistanceTolerance = 0.01f;
+
+    static float GetDistanceToSegment(const FVector3f& Point, const FVector3f& Start, const FVector3f& End)
+    {
+        const FVector3f Segment = End - Start;
+        const float SegmentSizeSquared = Segment.SizeSquared();
+        const float Alpha = SegmentSizeSquared > UE_SMALL_NUMBER ? FMath::Clamp(FVector3f::DotProduct(Point - Start, Segment) / SegmentSizeSquared, 0.0f, 1.0f) : 0.0f;
+
+        return FVector3f::Dist(Point, Start + Segment * Alpha);
+    }
+}
+
+using namespace LineRendererTests;
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FLineRingBufferAppendTest, "LineRenderer.Sections.RingBufferAppend", EAutomationTestFlags::EditorContext | EAutomationTestFlags::ClientContext | EAutomationTestFlags::EngineFilter)
+
+bool FLineRingBufferAppendTest::RunTest(const FString& Parameters)
+{
+    static constexpr int32 MaxPoints = 16;
+    static constexpr int32 NumAppends = 100;
+    static constexpr float Spacing = 10.0f;
+    static constexpr float Thickness = 2.0f;
+
+    // The trail walks towards the origin, which the component bounds always contain
+    auto GetTrailPoint = [](int32 PointIndex)
+    {
+        return FVector((NumAppends - PointIndex) * Spacing, 0.0f, 0.0f);
+    };
+
+    // No world and no proxy, the component keeps its sections and bounds on its own
+    ULineRendererComponent* Component = NewObject<ULineRendererComponent>(GetTransientPackage(), NAME_None, RF_Transient);
+
+    for (int32 PointIndex = 0; PointIndex < NumAppends; ++PointIndex)
+    {
+        Component->AppendPointsToLine(0, { GetTrailPoint(PointIndex) }, FLinearColor::White, Thickness, false, MaxPoints);
+
+        if (!TestEqual(FString::Printf(TEXT("Points after append %d"), PointIndex), Component->GetNumPointsInSection(0), FMath::Min(PointIndex + 1, MaxPoints)))
+        {
+            return false;
+        }
+    }
+
+    const FBox Box = Component->CalcBounds(FTransform::Identity).GetBox();
+
+    for (int32 PointIndex = NumAppends - MaxPoints; PointIndex < NumAppends; ++PointIndex)
+    {
+        TestTrue(FString::Printf(TEXT("Bounds contain kept point %d"), PointIndex), Box.IsInsideOrOn(GetTrailPoint(PointIndex)));
+    }
+
+    // Dropped points are compacted away once they outnumber the kept ones, the box covers at most twice the kept points
+    TestTrue(TEXT("Bounds shrink with dropped points"), Box.Max.X <= GetTrailPoint(NumAppends - 2 * MaxPoints - 1).X + Thickness + DistanceTolerance);
+
+    // A batch longer than the ring keeps its newest points, whether it starts the section or continues it
+    TArray<FVector> Batch;
+    for (int32 PointIndex = 0; PointIndex < 3 * MaxPoints; ++PointIndex)
+    {
+        Batch.Add(FVector(0.0f, PointIndex * Spacing, 0.0f));
+    }
+
+    Component->AppendPointsToLine(1, Batch, FLinearColor::White, Thickness, false, MaxPoints);
+    TestEqual(TEXT("Points of a new section"), Component->GetNumPointsInSection(1), MaxPoints);
+
+    Component->AppendPointsToLine(1, Batch, FLinearColor::White, Thickness, false, MaxPoints);
+    TestEqual(TEXT("Points of a continued section"), Component->GetNumPointsInSection(1), MaxPoints);
+
+    // Without a limit every point is kept
+    Component->AppendPointsToLine(2, Batch, FLinearColor::White, Thickness, false, 0);
+    Component->AppendPointsToLine(2, Batch, FLinearColor::White, Thickness, false, 0);
+    TestEqual(TEXT("Points of an unlimited section"), Component->GetNumPointsInSection(2), 2 * Batch.Num());
+
+    return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FLineSlotMapHandlesTest, "LineRenderer.Sections.SlotMapHandles", EAutomationTestFlags::EditorContext | EAutomationTestFlags::ClientContext | EAutomationTestFlags::EngineFilter)
+
+bool FLineSlotMapHandlesTest::RunTest(const FString& Parameters)
+{
+    TLineSectionSlotMap<int32> SlotMap;
+
+    const FLineSectionHandle Handle1 = SlotMap.Add(1, 100);
+    const FLineSectionHandle Handle2 = SlotMap.Add(2, 200);
+    const FLineSectionHandle Handle3 = SlotMap.Add(3, 300);
+
+    TestTrue(TEXT("Removed existing key"), SlotMap.Remove(2));
+    TestFalse(TEXT("Removed missing key"), SlotMap.Remove(2));
+    TestEqual(TEXT("Sections after remove"), SlotMap.Num(), 2);
+
+    // The last section was swapped into the hole, its handle still finds it
+    TestTrue(TEXT("Removed handle is stale"), SlotMap.Find(Handle2) == nullptr);
+    TestTrue(TEXT("Swapped handle is valid"), SlotMap.Find(Handle3) != nullptr && *SlotMap.Find(Handle3) == 300);
+    TestTrue(TEXT("Other handle is valid"), SlotMap.Find(Handle1) != nullptr && *SlotMap.Find(Handle1) == 100);
+
+    // The free slot is reused under a new generation
+    const FLineSectionHandle Handle4 = SlotMap.Add(4, 400);
+    TestEqual(TEXT("Slot is reused"), Handle4.SlotIndex, Handle2.SlotIndex);
+    TestTrue(TEXT("Reused slot has a new handle"), Handle4 != Handle2);
+    TestTrue(TEXT("Stale handle does not find the new section"), SlotMap.Find(Handle2) == nullptr);
+    TestTrue(TEXT("New handle finds the new section"), SlotMap.Find(Handle4) != nullptr && *SlotMap.Find(Handle4) == 400);
+
+    // Replacing a key makes its old handle stale
+    const FLineSectionHandle Handle1Replaced = SlotMap.Add(1, 101);
+    TestTrue(TEXT("Replaced handle is stale"), SlotMap.Find(Handle1) == nullptr);
+    TestTrue(TEXT("Key finds the replacement"), SlotMap.Find(1) != nullptr && *SlotMap.Find(1) == 101);
+    TestTrue(TEXT("Key maps to the replacement handle"), SlotMap.GetHandle(1) == Handle1Replaced);
+
+    int32 Sum = 0;
+    for (int32 Value : SlotMap)
+    {
+        Sum += Value;
+    }
+    TestEqual(TEXT("Iterated sections"), Sum, 101 + 300 + 400);
+
+    SlotMap.Empty();
+    TestEqual(TEXT("Sections after empty"), SlotMap.Num(), 0);
+    TestTrue(TEXT("Handles are stale after empty"), SlotMap.Find(Handle3) == nullptr && SlotMap.Find(Handle4) == nullptr && SlotMap.Find(Handle1Replaced) == nullptr);
+    TestFalse(TEXT("Keys are gone after empty"), SlotMap.Contains(3));
+
+    return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FLineLODErrorBoundTest, "LineRenderer.LOD.ErrorBound", EAutomationTestFlags::EditorContext | EAutomationTestFlags::ClientContext | EAutomationTestFlags::EngineFilter)
+
+bool FLineLODErrorBoundTest::RunTest(const FString& Parameters)
+{
+    // Noisy joined polyline, simplified as a single run
+    FRandomStream Random(0x4c696e65);
+
+    TArray<FVector3f> Points;
+    for (int32 PointIndex = 0; PointIndex < 2000; ++PointIndex)
+    {
+        Points.Add(FVector3f(PointIndex * 5.0f, FMath::Sin(PointIndex * 0.01f) * 500.0f + Random.FRandRange(-2.0f, 2.0f), Random.FRandRange(-2.0f, 2.0f)));
+    }
+
+    TArray<FPackedLine> Lines;
+    for (int32 PointIndex = 0; PointIndex + 1 < Points.Num(); ++PointIndex)
+    {
+        FPackedLine& Line = Lines.AddDefaulted_GetRef();
+        Line.StartAndThickness = FVector4f(Points[PointIndex], 3.0f);
+        Line.End = FVector4f(Points[PointIndex + 1], 0.0f);
+        SetPackedLineColor(Line, FColor::White);
+    }
+
+    TArray<FLineLOD> LODs;
+    BuildLineLODs(Lines, LODs);
+
+    if (!TestTrue(TEXT("Long polyline has simplified levels"), LODs.Num() > 0))
+    {
+        return false;
+    }
+
+    int32 PreviousNumLines = Lines.Num();
+
+    for (int32 LODIndex = 0; LODIndex < LODs.Num(); ++LODIndex)
+    {
+        const FLineLOD& LOD = LODs[LODIndex];
+
+        TestTrue(FString::Printf(TEXT("LOD %d draws at most 3/4 of the previous level"), LODIndex), LOD.Lines.Num() * 4 <= PreviousNumLines * 3);
+        PreviousNumLines = LOD.Lines.Num();
+
+        // Kept points are a subsequence of the original points, every dropped point lies within Error of the line spanning it
+        int32 PointIndex = 0;
+        float MaxDistance = 0.0f;
+        bool bSubsequence = FVector3f(LOD.Lines[0].StartAndThickness) == Points[0];
+
+        for (const FPackedLine& Line : LOD.Lines)
+        {
+            const FVector3f Start(Line.StartAndThickness);
+            const FVector3f End(Line.End);
+
+            while (++PointIndex < Points.Num() && Points[PointIndex] != End)
+            {
+                MaxDistance = FMath::Max(MaxDistance, GetDistanceToSegment(Points[PointIndex], Start, End));
+            }
+
+            bSubsequence &= PointIndex < Points.Num();
+        }
+
+        TestTrue(FString::Printf(TEXT("LOD %d keeps original points in order"), LODIndex), bSubsequence && PointIndex == Points.Num() - 1);
+        TestTrue(FString::Printf(TEXT("LOD %d dropped points within %f, largest %f"), LODIndex, LOD.Error, MaxDistance), MaxDistance <= LOD.Error + DistanceTolerance);
+    }
+
+    return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
@@ -0,0 +1,250 @@
+// Copyright 2023 Petr Leontev. All Rights Reserved.
+
+#include "CoreMinimal.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "Math/RandomStream.h"
+#include "LineVertexExpansion.h"
+
+/*
+ * Correctness tests of the expansion kernels, run with:
+ * UnrealEditor-Cmd <Project> -nullrhi -unattended -ExecCmds="Automation RunTests LineRenderer.Expansion; Quit"
+ */
+
+namespace LineVertexExpansionTests
+{
+    /** Positions of the kernels are compared within this distance, lines are a few thousand units from the origin */
+    static constexpr float PositionTolerance = 0.01f;
+
+    static const TPair<ELineGeometryMode, const TCHAR*> Modes[] =
+    {
+        { ELineGeometryMode::Caps, TEXT("Caps") },
+        { ELineGeometryMode::Ribbon, TEXT("Ribbon") },
+        { ELineGeometryMode::Strip, TEXT("Strip") },
+    };
+
+    static FPackedLine MakeLine(const FVector3f& Start, const FVector3f& End, float Thickness)
+    {
+        FPackedLine Line;
+        Line.StartAndThickness = FVector4f(Start, Thickness);
+        Line.End = FVector4f(End, 0.0f);
+        SetPackedLineColor(Line, FColor::White);
+
+        return Line;
+    }
+
+    /** A joined polyline with a mitered and a beveled joint, a line pointing at the camera and a separate line */
+    static TArray<FPackedLine> MakeTestLines()
+    {
+        const FVector3f Points[] =
+        {
+            { 0.0f, 0.0f, 0.0f },
+            { 400.0f, 100.0f, 50.0f },
+            { 800.0f, 0.0f, 300.0f },
+            { 420.0f, 40.0f, 320.0f },
+            { -7000.0f, 0.0f, 3000.0f },
+        };
+
+        TArray<FPackedLine> Lines;
+
+        for (int32 PointIndex = 0; PointIndex + 1 < UE_ARRAY_COUNT(Points); ++PointIndex)
+        {
+            Lines.Add(MakeLine(Points[PointIndex], Points[PointIndex + 1], 4.0f + PointIndex));
+        }
+
+        Lines.Add(MakeLine(FVector3f(-200.0f, 500.0f, 100.0f), FVector3f(300.0f, 900.0f, -50.0f), 10.0f));
+
+        return Lines;
+    }
+
+    static FLineExpansionView MakeView()
+    {
+        const FMatrix ViewMatrix = FLookAtMatrix(FVector(-8000.0f, 0.0f, 3000.0f), FVector(0.0f, 0.0f, 500.0f), FVector::UpVector);
+        const FMatrix ProjectionMatrix = FReversedZPerspectiveMatrix(HALF_PI * 0.5f, 1920.0f, 1080.0f, 10.0f);
+        const FMatrix WorldToClip = ViewMatrix * ProjectionMatrix;
+
+        return FLineExpansionView(WorldToClip, WorldToClip.Inverse(), ProjectionMatrix, 1920);
+    }
+
+    /**
+     * Vertex of the ExpandLineVertices output that vertex id LineVertex of line LineIndex is drawn from,
+     * INDEX_NONE for the collapsed join quad of a strip line that is not joined to the previous one.
+     * Same index pattern as the ribbon index buffer and BuildStripIndices.
+     */
+    static int32 GetExpandedVertexIndex(ELineGeometryMode Mode, TConstArrayView<FPackedLine> Lines, int32 LineIndex, int32 LineVertex)
+    {
+        static const int32 RibbonCorners[NumIndicesPerRibbonLine] = { 0, 2, 1, 1, 2, 3 };
+
+        if (Mode == ELineGeometryMode::Caps)
+        {
+            return LineIndex * NumVerticesPerLine + LineVertex;
+        }
+
+        const int32 FirstVertex = LineIndex * NumVerticesPerRibbonLine;
+        const int32 Corner = RibbonCorners[LineVertex % NumIndicesPerRibbonLine];
+
+        if (LineVertex < NumIndicesPerRibbonLine)
+        {
+            return FirstVertex + Corner;
+        }
+
+        if (!IsJoinedToPreviousLine(Lines, LineIndex))
+        {
+            return INDEX_NONE;
+        }
+
+        // Join quad from the end of the previous line to the start of this one
+        const int32 JoinVertices[4] = { FirstVertex - 2, FirstVertex - 1, FirstVertex + 0, FirstVertex + 1 };
+
+        return JoinVertices[Corner];
+    }
+
+    /** Start or end point (bit 2) and corner (bits 0-1) of every caps vertex, same table as in LineVertexFactory.ush */
+    static const uint8 CapsCornerTable[NumVerticesPerLine] =
+    {
+        0, 1, 2,  1, 2, 3,
+        4, 5, 6,  5, 6, 7,
+        2, 1, 6,  1, 5, 6,
+        3, 0, 7,  0, 4, 7
+    };
+
+    /** Caps expansion as the scalar double precision loop computed it before the SIMD kernel */
+    static void ExpandCapsReference(const FLineExpansionView& View, bool bScreenSpace, TConstArrayView<FPackedLine> Lines, TArray<FVector>& OutVertices)
+    {
+        const FVector CameraX(View.CameraX);
+        const FVector CameraY(View.CameraY);
+
+        OutVertices.Reset(Lines.Num() * NumVerticesPerLine);
+
+        for (const FPackedLine& Line : Lines)
+        {
+            const FVector Points[2] = { FVector(FVector3f(Line.StartAndThickness)), FVector(FVector3f(Line.End)) };
+            double HalfThickness[2];
+
+            for (int32 PointIndex = 0; PointIndex < 2; ++PointIndex)
+            {
+                const double W = View.ClipW.X * Points[PointIndex].X + View.ClipW.Y * Points[PointIndex].Y + View.ClipW.Z * Points[PointIndex].Z + View.ClipW.W;
+                const double Scaling = bScreenSpace ? 2.0 * View.OrthoZoomFactor * W / View.ViewportSizeX : 1.0;
+
+                HalfThickness[PointIndex] = Line.StartAndThickness.W * Scaling * 0.5;
+            }
+
+            for (uint8 Corner : CapsCornerTable)
+            {
+                const int32 PointIndex = Corner >> 2;
+                const double SignX = (Corner & 3) < 2 ? 1.0 : -1.0;
+                const double SignY = (Corner & 1) ? 1.0 : -1.0;
+
+                OutVertices.Add(Points[PointIndex] + (CameraX * SignX + CameraY * SignY) * HalfThickness[PointIndex]);
+            }
+        }
+    }
+
+    /** Random walk long enough to be split across parallel expansion workers */
+    static TArray<FPackedLine> MakeRandomLines(int32 NumLines)
+    {
+        FRandomStream Random(0x4c696e65);
+
+        TArray<FPackedLine> Lines;
+        Lines.Reserve(NumLines);
+
+        FVector3f Point(-4000.0f, 0.0f, 500.0f);
+
+        for (int32 LineIndex = 0; LineIndex < NumLines; ++LineIndex)
+        {
+            const FVector3f Next = Point + FVector3f(Random.GetUnitVector()) * Random.FRandRange(1.0f, 50.0f);
+            Lines.Add(MakeLine(Point, Next, Random.FRandRange(0.5f, 20.0f)));
+            Point = Next;
+        }
+
+        return Lines;
+    }
+}
+
+using namespace LineVertexExpansionTests;
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FLineExpansionFromIdTest, "LineRenderer.Expansion.VertexFromId", EAutomationTestFlags::EditorContext | EAutomationTestFlags::ClientContext | EAutomationTestFlags::EngineFilter)
+
+bool FLineExpansionFromIdTest::RunTest(const FString& Parameters)
+{
+    const TArray<FPackedLine> Lines = MakeTestLines();
+    const FLineExpansionView View = MakeView();
+
+    TArray<FVector3f> Vertices;
+
+    for (const TPair<ELineGeometryMode, const TCHAR*>& Mode : Modes)
+    {
+        for (bool bScreenSpace : { false, true })
+        {
+            Vertices.SetNumUninitialized(Lines.Num() * GetNumVerticesPerLine(Mode.Key));
+            ExpandLineVertices(View, bScreenSpace, Mode.Key, Lines, Vertices.GetData());
+
+            const int32 IndicesPerLine = GetNumIndicesPerLine(Mode.Key);
+            int32 NumMismatches = 0;
+
+            for (int32 VertexId = 0; VertexId < Lines.Num() * IndicesPerLine; ++VertexId)
+            {
+                const int32 LineIndex = VertexId / IndicesPerLine;
+                const FVector3f FromId = ExpandLineVertexFromId(View, bScreenSpace, Mode.Key, Lines, VertexId);
+                const int32 ExpandedIndex = GetExpandedVertexIndex(Mode.Key, Lines, LineIndex, VertexId % IndicesPerLine);
+
+                // Unjoined strip lines collapse their join quad onto the line start
+                const FVector3f Expected = ExpandedIndex != INDEX_NONE ? Vertices[ExpandedIndex] : FVector3f(Lines[LineIndex].StartAndThickness);
+
+                if (!FromId.Equals(Expected, PositionTolerance))
+                {
+                    if (NumMismatches++ == 0)
+                    {
+                        AddError(FString::Printf(TEXT("%s ScreenSpace=%d vertex id %d: %s from id, %s expanded"),
+                            Mode.Value, bScreenSpace ? 1 : 0, VertexId, *FromId.ToString(), *Expected.ToString()));
+                    }
+                }
+            }
+
+            TestEqual(FString::Printf(TEXT("%s ScreenSpace=%d mismatching vertices"), Mode.Value, bScreenSpace ? 1 : 0), NumMismatches, 0);
+        }
+    }
+
+    return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FLineExpansionScalarParityTest, "LineRenderer.Expansion.ScalarParity", EAutomationTestFlags::EditorContext | EAutomationTestFlags::ClientContext | EAutomationTestFlags::EngineFilter)
+
+bool FLineExpansionScalarParityTest::RunTest(const FString& Parameters)
+{
+    const TArray<FPackedLine> Lines = MakeRandomLines(10000);
+    const FLineExpansionView View = MakeView();
+
+    TArray<FVector3f> Vertices;
+    TArray<FVector> Expected;
+
+    for (bool bScreenSpace : { false, true })
+    {
+        Vertices.SetNumUninitialized(Lines.Num() * NumVerticesPerLine);
+        ExpandLineVertices(View, bScreenSpace, ELineGeometryMode::Caps, Lines, Vertices.GetData());
+
+        ExpandCapsReference(View, bScreenSpace, Lines, Expected);
+
+        int32 NumMismatches = 0;
+
+        for (int32 VertexIndex = 0; VertexIndex < Vertices.Num(); ++VertexIndex)
+        {
+            if (!FVector(Vertices[VertexIndex]).Equals(Expected[VertexIndex], PositionTolerance))
+            {
+                if (NumMismatches++ == 0)
+                {
+                    AddError(FString::Printf(TEXT("ScreenSpace=%d vertex %d: %s SIMD, %s scalar"),
+                        bScreenSpace ? 1 : 0, VertexIndex, *Vertices[VertexIndex].ToString(), *Expected[VertexIndex].ToString()));
+                }
+            }
+        }
+
+        TestEqual(FString::Printf(TEXT("ScreenSpace=%d mismatching vertices"), bScreenSpace ? 1 : 0), NumMismatches, 0);
+    }
+
+    return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
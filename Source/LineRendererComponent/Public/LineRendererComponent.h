@@ -1,82 +1,158 @@
-// Copyright 2023 Petr Leontev. All Rights Reserved.
-
-#pragma once
-
-#include "CoreMinimal.h"
-#include "Components/MeshComponent.h"
-#include "Materials/MaterialRelevance.h"
-#include "Templates/SharedPointer.h"
-#include "LineSectionInfo.h"
-#include "LineRendererComponent.generated.h"
-
-class UMaterialInstanceDynamic;
-class UMaterialInterface;
-class FPrimitiveSceneProxy;
-class FLineRendererComponentSceneProxy;
-
-
-UCLASS(hidecategories = (Object, LOD), meta = (BlueprintSpawnableComponent))
-class LINERENDERERCOMPONENT_API ULineRendererComponent : public UMeshComponent
-{
-	GENERATED_BODY()
-
-public:
-	ULineRendererComponent(const FObjectInitializer& ObjectInitializer);
-
-	UFUNCTION(BlueprintCallable, Category = "Components|LineRenderer")
-	void CreateLine2Points(int32 SectionIndex, const FVector& StartPoint, const FVector& EndPoint, const FLinearColor& Color, float Thickness = 1.0f, int32 NumSegments = 1, bool bScreenSpace = false);
-
-	UFUNCTION(BlueprintCallable, Category = "Components|LineRenderer")
-	void CreateLine(int32 SectionIndex, const TArray<FVector>& Vertices, const FLinearColor& Color, float Thickness = 1.0f, bool bScreenSpace = false);
-
-	UFUNCTION(BlueprintCallable, Category = "Components|LineRenderer")
-	void RemoveLine(int32 SectionIndex);
-
-	UFUNCTION(BlueprintCallable, Category = "Components|LineRenderer")
-	void RemoveAllLines();
-
-	UFUNCTION(BlueprintCallable, Category = "Components|LineRenderer")
-	void SetLineVisible(int32 SectionIndex, bool bNewVisibility);
-
-	UFUNCTION(BlueprintCallable, Category = "Components|LineRenderer")
-	bool IsLineVisible(int32 SectionIndex) const;
-
-	/** Returns number of lines currently created for this component */
-	UFUNCTION(BlueprintCallable, Category = "Components|LineRenderer")
-	int32 GetNumSections() const;
-
-protected:
-	//~ Begin UPrimitiveComponent Interface.
-	virtual FPrimitiveSceneProxy* CreateSceneProxy() override;
-	//~ End UPrimitiveComponent Interface.
-
-	//~ Begin UMeshComponent Interface.
-	virtual UMaterialInterface* GetMaterial(int32 ElementIndex) const override;
-	virtual FMaterialRelevance GetMaterialRelevance(ERHIFeatureLevel::Type InFeatureLevel) const override;
-
-	virtual void GetUsedMaterials(TArray<UMaterialInterface*>& OutMaterials, bool bGetDebugMaterials = false) const override;
-	//~ End UMeshComponent Interface.
-
-protected:
-    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Components|LineRenderer")
-	UMaterialInterface* LineMaterial;
-
-private: 
-	UMaterialInterface* CreateOrUpdateMaterial(int32 SectionIndex, const FLinearColor& Color);
-
-	//~ Begin USceneComponent Interface.
-	virtual FBoxSphereBounds CalcBounds(const FTransform& LocalToWorld) const override;
-	virtual void UpdateBounds() override;
-	//~ Begin USceneComponent Interface.
-
-private:
-	UPROPERTY(Transient)
-    TMap<int32, FLineSectionInfo> Sections;
-
-	UPROPERTY(Transient)
-    TMap<int32, UMaterialInstanceDynamic*> SectionMaterials;
-
-    friend class FLineRendererComponentSceneProxy;
-};
-
-
+// Copyright 2023 Petr Leontev. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/MeshComponent.h"
+#include "Materials/MaterialRelevance.h"
+#include "Templates/SharedPointer.h"
+#include "LineSectionInfo.h"
+#include "LineSectionSlotMap.h"
+#include "LineRendererComponent.generated.h"
+
+class UMaterialInstanceDynamic;
+class UMaterialInterface;
+class FPrimitiveSceneProxy;
+class FLineRendererComponentSceneProxy;
+
+
+UCLASS(hidecategories = (Object, LOD), meta = (BlueprintSpawnableComponent))
+class LINERENDERERCOMPONENT_API ULineRendererComponent : public UMeshComponent
+{
+	GENERATED_BODY()
+
+public:
+	ULineRendererComponent(const FObjectInitializer& ObjectInitializer);
+
+	UFUNCTION(BlueprintCallable, Category = "Components|LineRenderer")
+	void CreateLine2Points(int32 SectionIndex, const FVector& StartPoint, const FVector& EndPoint, const FLinearColor& Color, float Thickness = 1.0f, int32 NumSegments = 1, bool bScreenSpace = false);
+
+	UFUNCTION(BlueprintCallable, Category = "Components|LineRenderer")
+	void CreateLine(int32 SectionIndex, const TArray<FVector>& Vertices, const FLinearColor& Color, float Thickness = 1.0f, bool bScreenSpace = false);
+
+	/** Creates or replaces every described section. Render data of the whole batch is sent with one render command */
+	UFUNCTION(BlueprintCallable, Category = "Components|LineRenderer")
+	void CreateLines(const TArray<FLineSectionDescription>& Lines);
+
+	/** Same as CreateLines, descriptions of sections that do not exist are skipped */
+	UFUNCTION(BlueprintCallable, Category = "Components|LineRenderer")
+	void UpdateLines(const TArray<FLineSectionDescription>& Lines);
+
+	/**
+	 * Appends points to the end of a line, for trails and live plots. Only the new segments are sent to the render thread,
+	 * into buffers that grow geometrically. With MaxPoints > 0 the oldest points are dropped to keep at most MaxPoints points.
+	 * Color, Thickness and bScreenSpace are only used when the line does not exist yet.
+	 * The line is drawn at full resolution while points are appended, simplified levels are built again once appends pause for a few frames.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Components|LineRenderer")
+	void AppendPointsToLine(int32 SectionIndex, const TArray<FVector>& Points, const FLinearColor& Color, float Thickness = 1.0f, bool bScreenSpace = false, int32 MaxPoints = 0);
+
+	/**
+	 * Moves points of an existing line, starting at point StartIndex, for lines whose number of points does not change.
+	 * Render resources of the line are reused, points past the end of the line are ignored.
+	 * The line is drawn at full resolution while its points move, simplified levels are built again once they stay still for a few frames.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Components|LineRenderer")
+	void UpdateLinePoints(int32 SectionIndex, int32 StartIndex, const TArray<FVector>& Points);
+
+	UFUNCTION(BlueprintCallable, Category = "Components|LineRenderer")
+	void RemoveLine(int32 SectionIndex);
+
+	UFUNCTION(BlueprintCallable, Category = "Components|LineRenderer")
+	void RemoveLines(const TArray<int32>& SectionIndices);
+
+	UFUNCTION(BlueprintCallable, Category = "Components|LineRenderer")
+	void RemoveAllLines();
+
+	UFUNCTION(BlueprintCallable, Category = "Components|LineRenderer")
+	void SetLineVisible(int32 SectionIndex, bool bNewVisibility);
+
+	UFUNCTION(BlueprintCallable, Category = "Components|LineRenderer")
+	bool IsLineVisible(int32 SectionIndex) const;
+
+	/** Returns number of lines currently created for this component */
+	UFUNCTION(BlueprintCallable, Category = "Components|LineRenderer")
+	int32 GetNumSections() const;
+
+	/** Returns number of points of the polyline of a section, 0 if there is no such section */
+	UFUNCTION(BlueprintCallable, Category = "Components|LineRenderer")
+	int32 GetNumPointsInSection(int32 SectionIndex) const;
+
+	/** Returns memory used by lines of this component, optionally per section */
+	FLineSectionMemoryStats GetLineMemoryStats(TMap<int32, FLineSectionMemoryStats>* OutSectionStats = nullptr) const;
+
+	//~ Begin UObject Interface.
+	virtual void GetResourceSizeEx(FResourceSizeEx& CumulativeResourceSize) override;
+	static void AddReferencedObjects(UObject* InThis, FReferenceCollector& Collector);
+	//~ End UObject Interface.
+
+protected:
+	//~ Begin UPrimitiveComponent Interface.
+	virtual FPrimitiveSceneProxy* CreateSceneProxy() override;
+	//~ End UPrimitiveComponent Interface.
+
+	//~ Begin UMeshComponent Interface.
+	virtual UMaterialInterface* GetMaterial(int32 ElementIndex) const override;
+	virtual FMaterialRelevance GetMaterialRelevance(ERHIFeatureLevel::Type InFeatureLevel) const override;
+
+	virtual void GetUsedMaterials(TArray<UMaterialInterface*>& OutMaterials, bool bGetDebugMaterials = false) const override;
+	//~ End UMeshComponent Interface.
+
+protected:
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Components|LineRenderer")
+	UMaterialInterface* LineMaterial;
+
+	/** Expand lines in the vertex shader instead of on the CPU every frame. Line data is uploaded once per section. Requires SM5 */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Components|LineRenderer")
+	bool bGPUExpansion;
+
+	/** Write line colors to the vertex color stream and draw all sections with LineMaterial, which must read VertexColor. No material instance is created per section */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Components|LineRenderer")
+	bool bVertexColor;
+
+	/** Geometry of every line. Ribbon draws one camera facing quad per line, 6 times fewer vertices than Caps */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Components|LineRenderer")
+	ELineGeometryMode LineGeometryMode;
+
+	/**
+	 * Build world space lines once as view independent tubes drawn from cached mesh draw commands, with no per frame render thread cost.
+	 * Creating, changing or removing such a line recreates the render state, meant for lines that rarely change. Screen space lines stay dynamic
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Components|LineRenderer")
+	bool bStaticLines;
+
+	/**
+	 * Whether creating lines waits for their buffers to be built on worker tasks, or returns right away and lets them appear once built.
+	 * Large batches are split across tasks either way. Static lines are always waited for
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Components|LineRenderer")
+	ELineSectionBuildMode SectionBuildMode;
+
+private: 
+	UMaterialInterface* CreateOrUpdateMaterial(int32 SectionIndex, const FLinearColor& Color);
+
+	/** Stores the section on the game thread only, see SendSectionsToProxy */
+	void AddSection(const FLineSectionDescription& Description);
+	/** Sends the given sections to the scene proxy in one batch, or recreates the render state if there is no proxy */
+	void SendSectionsToProxy(TConstArrayView<int32> SectionIndices);
+	/** Whether changing these sections invalidates static draws of the proxy, the render state is then recreated instead */
+	bool ChangesStaticSections(TConstArrayView<int32> SectionIndices) const;
+	/** Rebuilds LocalLinesBox from the cached boxes of the sections, O(sections) */
+	void UpdateLocalLinesBox();
+
+	//~ Begin USceneComponent Interface.
+	virtual FBoxSphereBounds CalcBounds(const FTransform& LocalToWorld) const override;
+	virtual void UpdateBounds() override;
+	//~ Begin USceneComponent Interface.
+
+private:
+	/** Sections by section index, stored contiguously. Their materials are reported by AddReferencedObjects */
+    TLineSectionSlotMap<FLineSectionInfo> Sections;
+
+	/** Union of the section boxes, CalcBounds reads it instead of visiting every line */
+	FBox LocalLinesBox = FBox(ForceInit);
+
+    friend class FLineRendererComponentSceneProxy;
+};
+
+
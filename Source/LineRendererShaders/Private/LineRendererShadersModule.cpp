@@ -0,0 +1,19 @@
+// Copyright 2023 Petr Leontev. All Rights Reserved.
+
+#include "LineRendererShadersModule.h"
+#include "Interfaces/IPluginManager.h"
+#include "Misc/Paths.h"
+#include "ShaderCore.h"
+
+void FLineRendererShadersModule::StartupModule()
+{
+	// Shaders of the line vertex factory
+	const FString PluginShaderDir = FPaths::Combine(IPluginManager::Get().FindPlugin(TEXT("LineRendererComponent"))->GetBaseDir(), TEXT("Shaders"));
+	AddShaderSourceDirectoryMapping(TEXT("/Plugin/LineRendererComponent"), PluginShaderDir);
+}
+
+void FLineRendererShadersModule::ShutdownModule()
+{
+}
+	
+IMPLEMENT_MODULE(FLineRendererShadersModule, LineRendererShaders)
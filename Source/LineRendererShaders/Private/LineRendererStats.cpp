@@ -0,0 +1,27 @@
+// Copyright 2023 Petr Leontev. All Rights Reserved.
+
+#include "LineRendererStats.h"
+
+DEFINE_STAT(STAT_LineRenderer_ExpansionCacheHits);
+DEFINE_STAT(STAT_LineRenderer_ExpansionCacheMisses);
+DEFINE_STAT(STAT_LineRenderer_MeshBatches);
+DEFINE_STAT(STAT_LineRenderer_MergedDrawsSaved);
+DEFINE_STAT(STAT_LineRenderer_CulledSections);
+DEFINE_STAT(STAT_LineRenderer_SharedExpansions);
+DEFINE_STAT(STAT_LineRenderer_SectionsDrawn);
+DEFINE_STAT(STAT_LineRenderer_SegmentsExpanded);
+DEFINE_STAT(STAT_LineRenderer_VerticesUploaded);
+DEFINE_STAT(STAT_LineRenderer_BytesUploaded);
+DEFINE_STAT(STAT_LineRenderer_GetMeshElements);
+DEFINE_STAT(STAT_LineRenderer_CullSections);
+DEFINE_STAT(STAT_LineRenderer_MergeBatches);
+DEFINE_STAT(STAT_LineRenderer_ExpandLines);
+DEFINE_STAT(STAT_LineRenderer_LockBuffers);
+DEFINE_STAT(STAT_LineRenderer_StoreSections);
+DEFINE_STAT(STAT_LineRenderer_CreateSections);
+DEFINE_STAT(STAT_LineRenderer_BuildSections);
+DEFINE_STAT(STAT_LineRenderer_InitSections);
+DEFINE_STAT(STAT_LineRenderer_UpdateSections);
+DEFINE_STAT(STAT_LineRenderer_ReleaseSections);
+DEFINE_STAT(STAT_LineRenderer_BuildLODs);
+DEFINE_STAT(STAT_LineRenderer_Bounds);
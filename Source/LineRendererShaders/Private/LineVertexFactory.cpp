@@ -0,0 +1,194 @@
+// Copyright 2023 Petr Leontev. All Rights Reserved.
+
+#include "LineVertexFactory.h"
+#include "MaterialDomain.h"
+#include "MeshMaterialShader.h"
+#include "MeshDrawShaderBindings.h"
+#include "RHIStaticStates.h"
+#include "Runtime/Launch/Resources/Version.h"
+#include "LineRendererStats.h"
+
+IMPLEMENT_GLOBAL_SHADER_PARAMETER_STRUCT(FLineVertexFactoryParameters, "LineVF");
+
+#if ENGINE_MAJOR_VERSION >= 4 && ENGINE_MINOR_VERSION > 2
+void FLineSegmentBuffer::InitRHI(FRHICommandListBase& RHICmdList)
+#else
+void FLineSegmentBuffer::InitRHI()
+#endif
+{
+    FRHIResourceCreateInfo CreateInfo(TEXT("LineSegments"));
+
+    const uint32 SizeInBytes = GetSizeInBytes();
+
+    LINE_RENDERER_SCOPE_CYCLE_COUNTER(STAT_LineRenderer_LockBuffers);
+    INC_DWORD_STAT_BY(STAT_LineRenderer_BytesUploaded, SizeInBytes);
+
+#if ENGINE_MAJOR_VERSION > 4 && ENGINE_MINOR_VERSION > 2
+    // Streaming sections and moved lines keep writing to their buffer
+    const EBufferUsageFlags Usage = IsDynamic() ? EBufferUsageFlags::Dynamic : EBufferUsageFlags::Static;
+
+    VertexBufferRHI = RHICmdList.CreateVertexBuffer(SizeInBytes, Usage | EBufferUsageFlags::ShaderResource, CreateInfo);
+
+    void* Data = RHICmdList.LockBuffer(VertexBufferRHI, 0, SizeInBytes, RLM_WriteOnly);
+    FMemory::Memzero(Data, SizeInBytes);
+    FMemory::Memcpy(Data, Lines.GetData(), Lines.Num() * sizeof(FPackedLine));
+    RHICmdList.UnlockBuffer(VertexBufferRHI);
+
+    SegmentSRV = RHICmdList.CreateShaderResourceView(VertexBufferRHI, sizeof(FVector4f), PF_R32G32B32A32_UINT);
+#else
+    // Streaming sections and moved lines keep writing to their buffer
+    const EBufferUsageFlags Usage = IsDynamic() ? BUF_Dynamic : BUF_Static;
+
+    VertexBufferRHI = RHICreateVertexBuffer(SizeInBytes, Usage | BUF_ShaderResource, CreateInfo);
+
+    void* Data = RHILockBuffer(VertexBufferRHI, 0, SizeInBytes, RLM_WriteOnly);
+    FMemory::Memzero(Data, SizeInBytes);
+    FMemory::Memcpy(Data, Lines.GetData(), Lines.Num() * sizeof(FPackedLine));
+    RHIUnlockBuffer(VertexBufferRHI);
+
+    SegmentSRV = RHICreateShaderResourceView(VertexBufferRHI, sizeof(FVector4f), PF_R32G32B32A32_UINT);
+#endif
+}
+
+void FLineSegmentBuffer::WriteLines(FRHICommandListBase& RHICmdList, uint32 FirstSlot, TConstArrayView<FPackedLine> NewLines)
+{
+    const uint32 NumSlots = GetNumSlots();
+    check(IsDynamic());
+    check(NewLines.Num() <= (int32)NumSlots);
+
+    LINE_RENDERER_SCOPE_CYCLE_COUNTER(STAT_LineRenderer_LockBuffers);
+    INC_DWORD_STAT_BY(STAT_LineRenderer_BytesUploaded, NewLines.Num() * sizeof(FPackedLine));
+
+    uint32 Slot = FirstSlot % NumSlots;
+    int32 NumWritten = 0;
+
+    // At most two locks, one up to the end of the buffer and one from its start
+    while (NumWritten < NewLines.Num())
+    {
+        const int32 NumToWrite = FMath::Min(NewLines.Num() - NumWritten, (int32)(NumSlots - Slot));
+        const uint32 Offset = Slot * sizeof(FPackedLine);
+        const uint32 Size = NumToWrite * sizeof(FPackedLine);
+
+#if ENGINE_MAJOR_VERSION > 4 && ENGINE_MINOR_VERSION > 3
+        void* Data = RHICmdList.LockBuffer(VertexBufferRHI, Offset, Size, RLM_WriteOnly);
+        FMemory::Memcpy(Data, NewLines.GetData() + NumWritten, Size);
+        RHICmdList.UnlockBuffer(VertexBufferRHI);
+#else
+        void* Data = RHILockBuffer(VertexBufferRHI, Offset, Size, RLM_WriteOnly);
+        FMemory::Memcpy(Data, NewLines.GetData() + NumWritten, Size);
+        RHIUnlockBuffer(VertexBufferRHI);
+#endif
+
+        NumWritten += NumToWrite;
+        Slot = 0;
+    }
+}
+
+void FLineSegmentBuffer::ReleaseRHI()
+{
+    SegmentSRV.SafeRelease();
+    FVertexBuffer::ReleaseRHI();
+}
+
+class FLineVertexFactoryShaderParameters : public FVertexFactoryShaderParameters
+{
+    DECLARE_TYPE_LAYOUT(FLineVertexFactoryShaderParameters, NonVirtual);
+
+public:
+    void GetElementShaderBindings(
+        const FSceneInterface* Scene,
+        const FSceneView* View,
+        const FMeshMaterialShader* Shader,
+        const EVertexInputStreamType InputStreamType,
+        ERHIFeatureLevel::Type FeatureLevel,
+        const FVertexFactory* VertexFactory,
+        const FMeshBatchElement& BatchElement,
+        FMeshDrawSingleShaderBindings& ShaderBindings,
+        FVertexInputStreamArray& VertexStreams) const
+    {
+        const FLineVertexFactory* LineVertexFactory = static_cast<const FLineVertexFactory*>(VertexFactory);
+
+        ShaderBindings.Add(Shader->GetUniformBufferParameter<FLineVertexFactoryParameters>(), LineVertexFactory->GetUniformBuffer());
+    }
+};
+
+IMPLEMENT_TYPE_LAYOUT(FLineVertexFactoryShaderParameters);
+
+bool FLineVertexFactory::ShouldCompilePermutation(const FVertexFactoryShaderPermutationParameters& Parameters)
+{
+    // Vertex id expansion needs buffer loads in the vertex shader
+    return IsFeatureLevelSupported(Parameters.Platform, ERHIFeatureLevel::SM5)
+        && (Parameters.MaterialParameters.MaterialDomain == MD_Surface || Parameters.MaterialParameters.bIsSpecialEngineMaterial);
+}
+
+void FLineVertexFactory::ModifyCompilationEnvironment(const FVertexFactoryShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment)
+{
+    OutEnvironment.SetDefine(TEXT("LINE_VERTICES_PER_LINE"), NumVerticesPerLine);
+    OutEnvironment.SetDefine(TEXT("LINE_VERTICES_PER_RIBBON"), NumIndicesPerRibbonLine);
+    OutEnvironment.SetDefine(TEXT("LINE_VERTICES_PER_STRIP"), NumIndicesPerStripLine);
+    OutEnvironment.SetDefine(TEXT("LINE_MITER_LIMIT"), LineMiterLimit);
+
+    OutEnvironment.SetDefine(TEXT("LINE_GEOMETRY_CAPS"), LineGeometryModeCaps);
+    OutEnvironment.SetDefine(TEXT("LINE_GEOMETRY_RIBBON"), LineGeometryModeRibbon);
+    OutEnvironment.SetDefine(TEXT("LINE_GEOMETRY_STRIP"), LineGeometryModeStrip);
+}
+
+bool FLineVertexFactory::IsSupported(ERHIFeatureLevel::Type InFeatureLevel)
+{
+    return InFeatureLevel >= ERHIFeatureLevel::SM5;
+}
+
+void FLineVertexFactory::SetSegmentBuffer(const FLineSegmentBuffer* InSegmentBuffer, bool bInScreenSpace, ELineGeometryMode InMode)
+{
+    SegmentBuffer = InSegmentBuffer;
+    bScreenSpace = bInScreenSpace;
+    Mode = InMode;
+}
+
+#if ENGINE_MAJOR_VERSION >= 4 && ENGINE_MINOR_VERSION > 2
+void FLineVertexFactory::InitRHI(FRHICommandListBase& RHICmdList)
+#else
+void FLineVertexFactory::InitRHI()
+#endif
+{
+    check(SegmentBuffer != nullptr);
+
+    // Everything is fetched from the segment buffer by vertex id
+    FVertexDeclarationElementList Elements;
+    InitDeclaration(Elements);
+
+    CreateUniformBuffer();
+}
+
+void FLineVertexFactory::UpdateLineRange()
+{
+    check(IsInitialized());
+
+    CreateUniformBuffer();
+}
+
+void FLineVertexFactory::CreateUniformBuffer()
+{
+    FLineVertexFactoryParameters Parameters;
+    Parameters.SegmentBuffer = SegmentBuffer->GetSRV();
+    Parameters.bScreenSpace = bScreenSpace ? 1 : 0;
+    Parameters.GeometryMode = (uint32)Mode;
+    Parameters.NumLines = SegmentBuffer->Lines.Num();
+    Parameters.FirstLine = SegmentBuffer->FirstLine;
+    Parameters.Capacity = SegmentBuffer->GetNumSlots();
+
+    UniformBuffer = FLineVertexFactoryUniformBufferRef::CreateUniformBufferImmediate(Parameters, UniformBuffer_MultiFrame);
+}
+
+void FLineVertexFactory::ReleaseRHI()
+{
+    UniformBuffer.SafeRelease();
+    FVertexFactory::ReleaseRHI();
+}
+
+IMPLEMENT_VERTEX_FACTORY_PARAMETER_TYPE(FLineVertexFactory, SF_Vertex, FLineVertexFactoryShaderParameters);
+
+IMPLEMENT_VERTEX_FACTORY_TYPE(FLineVertexFactory, "/Plugin/LineRendererComponent/Private/LineVertexFactory.ush",
+    EVertexFactoryFlags::UsedWithMaterials
+    | EVertexFactoryFlags::SupportsDynamicLighting
+);
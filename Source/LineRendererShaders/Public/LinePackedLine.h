@@ -0,0 +1,56 @@
+// Copyright 2023 Petr Leontev. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/* Line layout shared by the CPU expansion kernel and the line vertex factory */
+
+/** Number of vertices a line is expanded into: two end caps and two crossing quads */
+static constexpr int32 NumVerticesPerLine = 24;
+
+/** Number of vertices and indices of a line expanded into a single quad */
+static constexpr int32 NumVerticesPerRibbonLine = 4;
+static constexpr int32 NumIndicesPerRibbonLine = 6;
+
+/** Strip segments use the ribbon vertices plus a join quad towards the previous segment */
+static constexpr int32 NumIndicesPerStripLine = 12;
+
+/** Joints sharper than this ratio of miter length to half thickness are beveled */
+static constexpr float LineMiterLimit = 4.0f;
+
+/** Declared with the other section settings, its values are mirrored here for the shader defines */
+enum class ELineGeometryMode : uint8;
+
+static constexpr uint32 LineGeometryModeCaps = 0;
+static constexpr uint32 LineGeometryModeRibbon = 1;
+static constexpr uint32 LineGeometryModeStrip = 2;
+
+/** Line endpoints packed for the expansion kernel, 32 bytes per line */
+struct FPackedLine
+{
+    /** Line start, W holds line thickness, negative for screen space lines of merged GPU batches */
+    FVector4f StartAndThickness;
+    /** Line end, W holds the bits of the line color, see SetPackedLineColor */
+    FVector4f End;
+};
+
+/** Stores the color bit for bit in End.W, the GPU reads it back as uint */
+inline void SetPackedLineColor(FPackedLine& Line, FColor Color)
+{
+    const uint32 ColorBits = Color.DWColor();
+    FMemory::Memcpy(&Line.End.W, &ColorBits, sizeof(ColorBits));
+}
+
+inline FColor GetPackedLineColor(const FPackedLine& Line)
+{
+    uint32 ColorBits;
+    FMemory::Memcpy(&ColorBits, &Line.End.W, sizeof(ColorBits));
+    return FColor(ColorBits);
+}
+
+/** Flags a line as screen space through the sign bit of its thickness, for segment buffers mixing both kinds of lines */
+inline void SetPackedLineScreenSpace(FPackedLine& Line)
+{
+    Line.StartAndThickness.W = -FMath::Abs(Line.StartAndThickness.W);
+}
@@ -0,0 +1,42 @@
+// Copyright 2023 Petr Leontev. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Stats/Stats.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
+
+DECLARE_STATS_GROUP(TEXT("LineRenderer"), STATGROUP_LineRenderer, STATCAT_Advanced);
+
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Expansion cache hits"), STAT_LineRenderer_ExpansionCacheHits, STATGROUP_LineRenderer, LINERENDERERSHADERS_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Expansion cache misses"), STAT_LineRenderer_ExpansionCacheMisses, STATGROUP_LineRenderer, LINERENDERERSHADERS_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Mesh batches"), STAT_LineRenderer_MeshBatches, STATGROUP_LineRenderer, LINERENDERERSHADERS_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Draws saved by merging sections"), STAT_LineRenderer_MergedDrawsSaved, STATGROUP_LineRenderer, LINERENDERERSHADERS_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Sections culled by view frustum"), STAT_LineRenderer_CulledSections, STATGROUP_LineRenderer, LINERENDERERSHADERS_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Expansions shared between stereo views"), STAT_LineRenderer_SharedExpansions, STATGROUP_LineRenderer, LINERENDERERSHADERS_API);
+
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Sections drawn"), STAT_LineRenderer_SectionsDrawn, STATGROUP_LineRenderer, LINERENDERERSHADERS_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Segments expanded"), STAT_LineRenderer_SegmentsExpanded, STATGROUP_LineRenderer, LINERENDERERSHADERS_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Vertices uploaded"), STAT_LineRenderer_VerticesUploaded, STATGROUP_LineRenderer, LINERENDERERSHADERS_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Bytes uploaded"), STAT_LineRenderer_BytesUploaded, STATGROUP_LineRenderer, LINERENDERERSHADERS_API);
+
+DECLARE_CYCLE_STAT_EXTERN(TEXT("GetDynamicMeshElements"), STAT_LineRenderer_GetMeshElements, STATGROUP_LineRenderer, LINERENDERERSHADERS_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Section culling and LOD selection"), STAT_LineRenderer_CullSections, STATGROUP_LineRenderer, LINERENDERERSHADERS_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Merged batch rebuild"), STAT_LineRenderer_MergeBatches, STATGROUP_LineRenderer, LINERENDERERSHADERS_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Line expansion"), STAT_LineRenderer_ExpandLines, STATGROUP_LineRenderer, LINERENDERERSHADERS_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Buffer lock and unlock"), STAT_LineRenderer_LockBuffers, STATGROUP_LineRenderer, LINERENDERERSHADERS_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Section storage (game thread)"), STAT_LineRenderer_StoreSections, STATGROUP_LineRenderer, LINERENDERERSHADERS_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Section creation (game thread)"), STAT_LineRenderer_CreateSections, STATGROUP_LineRenderer, LINERENDERERSHADERS_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Section build (task)"), STAT_LineRenderer_BuildSections, STATGROUP_LineRenderer, LINERENDERERSHADERS_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Section initialization (render thread)"), STAT_LineRenderer_InitSections, STATGROUP_LineRenderer, LINERENDERERSHADERS_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Section updates (render thread)"), STAT_LineRenderer_UpdateSections, STATGROUP_LineRenderer, LINERENDERERSHADERS_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Section release (render thread)"), STAT_LineRenderer_ReleaseSections, STATGROUP_LineRenderer, LINERENDERERSHADERS_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("LOD simplification (task)"), STAT_LineRenderer_BuildLODs, STATGROUP_LineRenderer, LINERENDERERSHADERS_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Bounds"), STAT_LineRenderer_Bounds, STATGROUP_LineRenderer, LINERENDERERSHADERS_API);
+
+/** Cycle counter of stat LineRenderer, also a CPU scope in Unreal Insights. Builds without stats keep the Insights scope */
+#if STATS
+#define LINE_RENDERER_SCOPE_CYCLE_COUNTER(Stat) SCOPE_CYCLE_COUNTER(Stat)
+#else
+#define LINE_RENDERER_SCOPE_CYCLE_COUNTER(Stat) TRACE_CPUPROFILER_EVENT_SCOPE(Stat)
+#endif
@@ -0,0 +1,110 @@
+// Copyright 2023 Petr Leontev. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "RenderResource.h"
+#include "VertexFactory.h"
+#include "ShaderParameterMacros.h"
+#include "UniformBuffer.h"
+#include "Runtime/Launch/Resources/Version.h"
+#include "LinePackedLine.h"
+
+BEGIN_GLOBAL_SHADER_PARAMETER_STRUCT(FLineVertexFactoryParameters, )
+    SHADER_PARAMETER_SRV(Buffer<uint4>, SegmentBuffer)
+    SHADER_PARAMETER(uint32, bScreenSpace)
+    SHADER_PARAMETER(uint32, GeometryMode)
+    SHADER_PARAMETER(uint32, NumLines)
+    SHADER_PARAMETER(uint32, FirstLine)
+    SHADER_PARAMETER(uint32, Capacity)
+END_GLOBAL_SHADER_PARAMETER_STRUCT()
+
+typedef TUniformBufferRef<FLineVertexFactoryParameters> FLineVertexFactoryUniformBufferRef;
+
+/** Line endpoints, thickness and color uploaded once for GPU expansion, two uint4 per line read as raw bits */
+class LINERENDERERSHADERS_API FLineSegmentBuffer : public FVertexBuffer
+{
+public:
+    /** Lines to upload, must stay alive until the resource is initialized */
+    TConstArrayView<FPackedLine> Lines;
+    /** Number of lines the buffer has room for, 0 to fit Lines exactly. Streaming sections reserve room for appended lines */
+    int32 Capacity = 0;
+    /** Slot of the first line, lines past the end of the buffer wrap around to its start */
+    uint32 FirstLine = 0;
+    /** Whether lines are rewritten after the buffer is created, set before InitResource. Streaming buffers always are */
+    bool bDynamic = false;
+
+    // FRenderResource interface.
+#if ENGINE_MAJOR_VERSION >= 4 && ENGINE_MINOR_VERSION > 2
+    virtual void InitRHI(FRHICommandListBase& RHICmdList) override;
+#else
+    virtual void InitRHI() override;
+#endif
+    virtual void ReleaseRHI() override;
+
+    FRHIShaderResourceView* GetSRV() const { return SegmentSRV; }
+
+    /** Whether the buffer is created for WriteLines, static buffers are only written by InitRHI */
+    bool IsDynamic() const { return bDynamic || Capacity > 0; }
+
+    /** Writes lines to consecutive slots starting at FirstSlot, wrapping around the end of the buffer. Only for dynamic buffers */
+    void WriteLines(FRHICommandListBase& RHICmdList, uint32 FirstSlot, TConstArrayView<FPackedLine> NewLines);
+
+    /** Number of line slots of the GPU buffer, never empty so that the SRV is always valid */
+    int32 GetNumSlots() const { return FMath::Max3(Capacity, Lines.Num(), 1); }
+
+    /** Size of the GPU buffer */
+    uint32 GetSizeInBytes() const { return GetNumSlots() * sizeof(FPackedLine); }
+
+private:
+    FShaderResourceViewRHIRef SegmentSRV;
+};
+
+/**
+ * Vertex factory expanding camera facing lines in the vertex shader, one instance per line.
+ * Draws are non-indexed, every instance is the same GetNumIndicesPerLine(Mode) vertex pattern, no vertex streams are bound.
+ * The segment buffer is the per-instance data, 32 bytes per line.
+ */
+class LINERENDERERSHADERS_API FLineVertexFactory : public FVertexFactory
+{
+    DECLARE_VERTEX_FACTORY_TYPE(FLineVertexFactory);
+
+public:
+    FLineVertexFactory(ERHIFeatureLevel::Type InFeatureLevel)
+        : FVertexFactory(InFeatureLevel)
+        , SegmentBuffer(nullptr)
+        , bScreenSpace(false)
+        , Mode((ELineGeometryMode)LineGeometryModeCaps)
+    {}
+
+    static bool ShouldCompilePermutation(const FVertexFactoryShaderPermutationParameters& Parameters);
+    static void ModifyCompilationEnvironment(const FVertexFactoryShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment);
+
+    /** Whether GPU expansion can be used on this feature level */
+    static bool IsSupported(ERHIFeatureLevel::Type InFeatureLevel);
+
+    void SetSegmentBuffer(const FLineSegmentBuffer* InSegmentBuffer, bool bInScreenSpace, ELineGeometryMode InMode);
+
+    /** Picks up new lines or a new first slot of the segment buffer after lines were written to it */
+    void UpdateLineRange();
+
+    // FRenderResource interface.
+#if ENGINE_MAJOR_VERSION >= 4 && ENGINE_MINOR_VERSION > 2
+    virtual void InitRHI(FRHICommandListBase& RHICmdList) override;
+#else
+    virtual void InitRHI() override;
+#endif
+    virtual void ReleaseRHI() override;
+
+    FRHIUniformBuffer* GetUniformBuffer() const { return UniformBuffer.GetReference(); }
+
+private:
+    void CreateUniformBuffer();
+
+private:
+    const FLineSegmentBuffer* SegmentBuffer;
+    bool bScreenSpace;
+    ELineGeometryMode Mode;
+
+    FLineVertexFactoryUniformBufferRef UniformBuffer;
+};